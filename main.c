@@ -1,4 +1,15 @@
+#include <limits.h>
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
 #include "raylib.h"
 #include "raymath.h"
 
@@ -19,195 +30,4005 @@
         240, 212, 58, 255 \
     }
 
-typedef enum { EMPTY, CONDUCTOR, HEAD, TAIL } Cell;
+enum { EMPTY, CONDUCTOR, HEAD, TAIL };
 
-typedef enum { UP, DOWN, LEFT, RIGHT } Direction;
+// One byte per cell; Wireworld only needs the four states above.
+typedef uint8_t Cell;
 
+// A simulation engine advances the global grid by a number of generations.
+// Engines may keep their own representation between calls, but the grid is
+// up to date whenever step returns.
 typedef struct {
-    Vector2 position;
+    const char* name;
+    void (*step)(int generations);
+    void (*release)(void);
+} Engine;
+
+// The contiguous window the engines step. It covers every stored chunk
+// (see FitGrid), and its cells outside the chunks are EMPTY.
+typedef struct {
+    int top;   // board coordinates of cell (0, 0)
+    int left;
     int rows;
     int cols;
-    Cell** cells;
+    int stride;  // cells per row in memory, padded to a cache line
+    Cell* cells;
+    Cell* nextCells;  // back buffer the next generation is written into
+    unsigned long version;  // bumped whenever the cells change
 } Grid;
 
-const int screenWidth = 1600;
-const int screenHeight = 1200;
+// The board is an unbounded plane of EMPTY cells. Only the chunkSize x
+// chunkSize chunks holding non-EMPTY cells are stored, in a hash map keyed
+// by chunk coordinates: a chunk is allocated by the first write into it
+// and freed when its last non-EMPTY cell is erased.
+typedef struct {
+    int row, col;  // chunk coordinates, in units of chunkSize cells
+    int count;     // non-EMPTY cells; 0 marks a free slot
+    Cell* cells;   // chunkSize x chunkSize, NULL while they are in the grid
+} Chunk;
+
+typedef struct {
+    Chunk* slots;  // open addressing with linear probing
+    int capacity;  // a power of two, or 0
+    int count;
+    int loose;   // chunks keeping their own cells rather than in the grid
+    bool moved;  // chunks were added or removed since the grid was fitted
+} ChunkMap;
+
+const int screenWidth = 1600;
+const int screenHeight = 1200;
+
+int cellSize = 40;
+const int minCellSize = 10;
+const int maxCellSize = 100;
+
+const int chunkLevel = 6;
+const int chunkSize = 1 << chunkLevel;
+// The grid is only used while it is at most this many times the area of
+// the chunks it covers, and never above maxGridCells; sparser boards are
+// stepped from their chunks instead.
+const int maxGridSparseness = 4;
+const long long maxGridCells = 1LL << 27;
+// Sparse batches of at least this many generations go through HashLife.
+const int chunkJumpLimit = 1024;
+const int gridAlignment = 64;
+const int zoomSpeed = 3;
+
+const int indicatorSize = 40;
+const int indicatorPadding = 20;
+const int indicatorX = screenWidth - indicatorSize * 4 - indicatorPadding;
+const int indicatorY = indicatorPadding;
+
+const int playButtonX = 20;
+const int playButtonY = 20;
+const int playButtonSize = 40;
+const int playButtonBarWidth = playButtonSize / 4;
+const int playButtonBarGap = playButtonBarWidth;
+
+const int nextButtonX = playButtonX + playButtonSize + 20;
+const int nextButtonY = 20;
+const int nextButtonSize = 40;
+const int nextButtonBarWidth = playButtonSize / 4;
+
+const int statusX = 20;
+const int statusY = playButtonY + playButtonSize + 20;
+const int statusFontSize = 20;
+const int statusLineHeight = statusFontSize + 5;
+
+const Rectangle playButtonRect = {playButtonX, playButtonY, playButtonSize,
+                                  playButtonSize};
+const Rectangle nextButtonRect = {nextButtonX, nextButtonY, nextButtonSize,
+                                  nextButtonSize};
+const Rectangle indicatorGruopRect = {indicatorX, indicatorY, indicatorSize * 4,
+                                      indicatorSize};
+
+bool isPlaying = false;
+bool quitRequested = false;
+
+// Digits typed after G, at most 19 so the target fits in 64 bits.
+char gotoInput[20] = "";
+bool enteringGoto = false;
+// Gotos queued so far; one is pending until a snapshot reports as many done.
+unsigned long long gotosQueued = 0;
+
+unsigned long long generation = 0;
+
+int jumpExponent = 10;
+const int maxJumpExponent = 40;
+
+// Playback speeds in generations per second. 0 runs as fast as the engine
+// allows, publishing one snapshot per frameBudget milliseconds of work.
+const int speeds[] = {1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 0};
+const int speedCount = sizeof(speeds) / sizeof(speeds[0]);
+int speedIndex = 2;
+float frameBudget = 16.0f;
+
+Cell selectCellType = EMPTY;
+Cell cellTypes[] = {EMPTY, CONDUCTOR, HEAD, TAIL};
+
+Grid grid = {0, 0, 0, 0, 0, NULL, NULL, 0};
+ChunkMap board = {0};
+
+// World position of board cell (0, 0); zooming moves it.
+Vector2 boardPosition = {0.0f, 0.0f};
+
+Camera2D camera = {0};
+
+// The cells last reported on screen to the simulation.
+int sentTop = 0, sentLeft = 0, sentRows = -1, sentCols = -1;
+
+Color GetCellColor(Cell cell) {
+    switch (cell) {
+        case EMPTY:
+            return EMPTY_COLOR;
+        case HEAD:
+            return HEAD_COLOR;
+        case TAIL:
+            return TAIL_COLOR;
+        case CONDUCTOR:
+            return CONDUCTOR_COLOR;
+        default:
+            return EMPTY_COLOR;
+    }
+}
+
+Cell GetCell(int row, int col) {
+    return grid.cells[(size_t)row * grid.stride + col];
+}
+
+// Cell buffers carry a permanent one-cell EMPTY halo so that every cell,
+// including those on the border, can read all eight neighbours without
+// bounds checks. The stride always leaves at least one padding cell after
+// the last column, which doubles as the right halo of its own row and the
+// left halo of the next one. One extra row above and below, plus a cache
+// line in front for the top-left corner, complete the halo. A second spare
+// row below lets 2x2 block kernels read a whole 4x4 neighbourhood when the
+// row count is odd. Nothing may write outside [0, rows) x [0, cols).
+int GridStride(int cols) {
+    int cellsPerLine = gridAlignment / sizeof(Cell);
+    return (cols + cellsPerLine) / cellsPerLine * cellsPerLine;
+}
+
+int HaloCells(int stride) {
+    return gridAlignment / sizeof(Cell) + stride;
+}
+
+// Returns NULL when the memory is not available.
+Cell* AllocCells(int rows, int stride) {
+    size_t size = (HaloCells(stride) + (size_t)(rows + 2) * stride) *
+                  sizeof(Cell);
+    Cell* storage = aligned_alloc(gridAlignment, size);
+    if (!storage)
+        return NULL;
+    memset(storage, 0, size);
+    return storage + HaloCells(stride);
+}
+
+// Engines cannot step without their scratch memory, so running out of it
+// ends the program with a message instead of a crash.
+void OutOfMemory(void) {
+    fprintf(stderr, "Out of memory\n");
+    exit(EXIT_FAILURE);
+}
+
+// Allocations the program cannot go on without. Only the chunk map and
+// ResizeGrid allocate unchecked, since a load or edit that runs out of
+// memory there is undone and reported instead.
+void* CheckedMalloc(size_t size) {
+    void* memory = RL_MALLOC(size);
+    if (!memory && size)
+        OutOfMemory();
+    return memory;
+}
+
+void* CheckedCalloc(size_t count, size_t size) {
+    void* memory = RL_CALLOC(count, size);
+    if (!memory && count && size)
+        OutOfMemory();
+    return memory;
+}
+
+void* CheckedRealloc(void* memory, size_t size) {
+    memory = RL_REALLOC(memory, size);
+    if (!memory && size)
+        OutOfMemory();
+    return memory;
+}
+
+void FreeCells(Cell* cells, int stride) {
+    if (cells)
+        free(cells - HaloCells(stride));
+}
+
+// Offsets from a cell's index to its eight neighbours.
+void GetNeighborOffsets(int offsets[8]) {
+    int i = 0;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            if (y != 0 || x != 0)
+                offsets[i++] = y * grid.stride + x;
+        }
+    }
+}
+
+// Takes the cell and stride rather than reading the grid, so a caller that
+// stores through a Cell* does not force them to be reloaded every cell.
+int CountHeadNeighbors(const Cell* cell, int stride) {
+    const Cell* above = cell - stride;
+    const Cell* below = cell + stride;
+
+    return (above[-1] == HEAD) + (above[0] == HEAD) + (above[1] == HEAD) +
+           (cell[-1] == HEAD) + (cell[1] == HEAD) + (below[-1] == HEAD) +
+           (below[0] == HEAD) + (below[1] == HEAD);
+}
+
+void InitGrid(void) {
+    grid.stride = GridStride(grid.cols);
+    grid.cells = AllocCells(grid.rows, grid.stride);
+    grid.nextCells = AllocCells(grid.rows, grid.stride);
+    if (!grid.cells || !grid.nextCells)
+        OutOfMemory();
+    grid.version++;
+}
+
+void FreeGrid(void) {
+    FreeCells(grid.cells, grid.stride);
+    FreeCells(grid.nextCells, grid.stride);
+}
+
+int FloorDiv(int a, int b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+uint32_t HashChunk(int row, int col) {
+    uint32_t hash = (uint32_t)row * 0x9E3779B1u ^ (uint32_t)col * 0x85EBCA77u;
+    return hash ^ (hash >> 15);
+}
+
+// The chunk at chunk coordinates (row, col), or NULL if it is all EMPTY.
+Chunk* FindChunk(int row, int col) {
+    if (!board.capacity)
+        return NULL;
+    uint32_t mask = board.capacity - 1;
+    for (uint32_t i = HashChunk(row, col) & mask;; i = (i + 1) & mask) {
+        Chunk* chunk = &board.slots[i];
+        if (!chunk->count)
+            return NULL;
+        if (chunk->row == row && chunk->col == col)
+            return chunk;
+    }
+}
+
+Chunk* InsertChunk(Chunk chunk) {
+    uint32_t mask = board.capacity - 1;
+    uint32_t i = HashChunk(chunk.row, chunk.col) & mask;
+    while (board.slots[i].count)
+        i = (i + 1) & mask;
+    board.slots[i] = chunk;
+    return &board.slots[i];
+}
+
+// Keeps at most half the slots in use. Returns false if there is not
+// enough memory to grow.
+bool ReserveChunk(void) {
+    if (2 * (board.count + 1) <= board.capacity)
+        return true;
+    int capacity = board.capacity ? 2 * board.capacity : 64;
+    Chunk* slots = RL_CALLOC(capacity, sizeof(Chunk));
+    if (!slots)
+        return false;
+
+    Chunk* old = board.slots;
+    int oldCapacity = board.capacity;
+    board.slots = slots;
+    board.capacity = capacity;
+    for (int i = 0; i < oldCapacity; i++) {
+        if (old[i].count)
+            InsertChunk(old[i]);
+    }
+    RL_FREE(old);
+    return true;
+}
+
+// Stores a new all-EMPTY chunk, whose cells are already there if it lies
+// in the grid. The caller must make it non-EMPTY straight away, since a
+// zero count marks a free slot. Returns NULL if there is not enough memory.
+Chunk* AddChunk(int row, int col) {
+    long long top = (long long)row * chunkSize - grid.top;
+    long long left = (long long)col * chunkSize - grid.left;
+    bool inGrid = top >= 0 && top < grid.rows && left >= 0 && left < grid.cols;
+    Cell* cells = NULL;
+    if (!inGrid && !(cells = RL_CALLOC(chunkSize * chunkSize, sizeof(Cell))))
+        return NULL;
+    if (!ReserveChunk()) {
+        RL_FREE(cells);
+        return NULL;
+    }
+
+    board.count++;
+    board.loose += !inGrid;
+    board.moved = true;
+    return InsertChunk((Chunk){row, col, 0, cells});
+}
+
+void RemoveChunk(Chunk* chunk) {
+    if (chunk->cells) {
+        RL_FREE(chunk->cells);
+        board.loose--;
+    }
+    board.count--;
+    board.moved = true;
+
+    // Shift later chunks of the same probe run back into the hole.
+    uint32_t mask = board.capacity - 1;
+    uint32_t hole = chunk - board.slots;
+    for (uint32_t i = (hole + 1) & mask; board.slots[i].count;
+         i = (i + 1) & mask) {
+        Chunk* next = &board.slots[i];
+        uint32_t home = HashChunk(next->row, next->col) & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            board.slots[hole] = *next;
+            hole = i;
+        }
+    }
+    board.slots[hole] = (Chunk){0};
+}
+
+void FreeChunks(void) {
+    for (int i = 0; i < board.capacity; i++) {
+        RL_FREE(board.slots[i].cells);
+    }
+    RL_FREE(board.slots);
+    board = (ChunkMap){0};
+}
+
+// Row y of a stored chunk. Its chunkSize cells are contiguous wherever the
+// chunk lives.
+Cell* ChunkRow(const Chunk* chunk, int y) {
+    if (chunk->cells)
+        return &chunk->cells[y * chunkSize];
+    return &grid.cells[(size_t)(chunk->row * chunkSize + y - grid.top) *
+                           grid.stride +
+                       chunk->col * chunkSize - grid.left];
+}
+
+Cell GetBoardCell(int row, int col) {
+    Chunk* chunk =
+        FindChunk(FloorDiv(row, chunkSize), FloorDiv(col, chunkSize));
+    if (!chunk)
+        return EMPTY;
+    return ChunkRow(chunk, row - chunk->row * chunkSize)[col - chunk->col *
+                                                               chunkSize];
+}
+
+void SwapGrid(void) {
+    Cell* cells = grid.cells;
+    grid.cells = grid.nextCells;
+    grid.nextCells = cells;
+}
+
+// Next state of a cell indexed by its state and head-neighbour count. This
+// is the reference form of the rule; the engines compute the same thing
+// with compares and arithmetic, which vectorizes where a per-cell table
+// lookup does not.
+const Cell cellTransitions[4][9] = {
+    [EMPTY] = {EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY},
+    [CONDUCTOR] = {CONDUCTOR, HEAD, HEAD, CONDUCTOR, CONDUCTOR, CONDUCTOR,
+                   CONDUCTOR, CONDUCTOR, CONDUCTOR},
+    [HEAD] = {TAIL, TAIL, TAIL, TAIL, TAIL, TAIL, TAIL, TAIL, TAIL},
+    [TAIL] = {CONDUCTOR, CONDUCTOR, CONDUCTOR, CONDUCTOR, CONDUCTOR, CONDUCTOR,
+              CONDUCTOR, CONDUCTOR, CONDUCTOR},
+};
+
+void UpdateGrid(void) {
+    const Cell* cells = grid.cells;
+    Cell* nextCells = grid.nextCells;
+    int rows = grid.rows, cols = grid.cols, stride = grid.stride;
+    for (int y = 0; y < rows; y++) {
+        const Cell* row = &cells[(size_t)y * stride];
+        Cell* newRow = &nextCells[(size_t)y * stride];
+        for (int x = 0; x < cols; x++) {
+            Cell cell = row[x];
+            Cell heads = CountHeadNeighbors(&row[x], stride);
+            Cell fires = cell == CONDUCTOR && (heads == 1 || heads == 2);
+            newRow[x] = cell + (cell == HEAD) + fires - 2 * (cell == TAIL);
+        }
+    }
+
+    SwapGrid();
+}
+
+// Bitboard engine: HEAD, TAIL and CONDUCTOR live in separate bitplanes with
+// one bit per cell, and the rule is evaluated 64 cells at a time.
+typedef struct {
+    int rows;
+    int words;  // 64-bit words per row
+    uint64_t* storage;
+    uint64_t* zeroRow;  // stands in for the rows beyond the top and bottom
+    uint64_t* head;
+    uint64_t* tail;
+    uint64_t* conductor;
+    uint64_t* nextHead;
+    uint64_t* nextTail;
+    uint64_t* nextConductor;
+} Bitboard;
+
+Bitboard bitboard = {0};
+
+void ResizeBitboard(int rows, int cols) {
+    int words = (cols + 63) / 64;
+    if (bitboard.rows == rows && bitboard.words == words)
+        return;
+
+    size_t planeSize = (size_t)rows * words;
+    RL_FREE(bitboard.storage);
+    bitboard.storage = CheckedCalloc(planeSize * 6 + words, sizeof(uint64_t));
+    bitboard.zeroRow = bitboard.storage;
+    bitboard.head = bitboard.zeroRow + words;
+    bitboard.tail = bitboard.head + planeSize;
+    bitboard.conductor = bitboard.tail + planeSize;
+    bitboard.nextHead = bitboard.conductor + planeSize;
+    bitboard.nextTail = bitboard.nextHead + planeSize;
+    bitboard.nextConductor = bitboard.nextTail + planeSize;
+    bitboard.rows = rows;
+    bitboard.words = words;
+}
+
+void PackBitboard(void) {
+    for (int y = 0; y < grid.rows; y++) {
+        const Cell* row = &grid.cells[(size_t)y * grid.stride];
+        for (int w = 0; w < bitboard.words; w++) {
+            uint64_t head = 0, tail = 0, conductor = 0;
+            int end = grid.cols - w * 64 < 64 ? grid.cols - w * 64 : 64;
+            for (int b = 0; b < end; b++) {
+                Cell cell = row[w * 64 + b];
+                head |= (uint64_t)(cell == HEAD) << b;
+                tail |= (uint64_t)(cell == TAIL) << b;
+                conductor |= (uint64_t)(cell == CONDUCTOR) << b;
+            }
+            size_t i = (size_t)y * bitboard.words + w;
+            bitboard.head[i] = head;
+            bitboard.tail[i] = tail;
+            bitboard.conductor[i] = conductor;
+        }
+    }
+}
+
+void UnpackBitboard(void) {
+    for (int y = 0; y < grid.rows; y++) {
+        Cell* row = &grid.cells[(size_t)y * grid.stride];
+        for (int x = 0; x < grid.cols; x++) {
+            size_t i = (size_t)y * bitboard.words + x / 64;
+            uint64_t bit = (uint64_t)1 << (x % 64);
+            row[x] = (bitboard.head[i] & bit)        ? HEAD
+                     : (bitboard.tail[i] & bit)      ? TAIL
+                     : (bitboard.conductor[i] & bit) ? CONDUCTOR
+                                                     : EMPTY;
+        }
+    }
+}
+
+// Head bits of the west, centre and east neighbours of word w in a row,
+// aligned so that bit b of each mask belongs to column w * 64 + b.
+void ShiftedHeads(const uint64_t* row, int w, uint64_t* west,
+                  uint64_t* centre, uint64_t* east) {
+    uint64_t prev = w > 0 ? row[w - 1] : 0;
+    uint64_t next = w < bitboard.words - 1 ? row[w + 1] : 0;
+    *centre = row[w];
+    *west = (row[w] << 1) | (prev >> 63);
+    *east = (row[w] >> 1) | (next << 63);
+}
+
+void UpdateBitboard(void) {
+    for (int y = 0; y < bitboard.rows; y++) {
+        size_t offset = (size_t)y * bitboard.words;
+        const uint64_t* above =
+            y > 0 ? bitboard.head + offset - bitboard.words : bitboard.zeroRow;
+        const uint64_t* middle = bitboard.head + offset;
+        const uint64_t* below =
+            y < bitboard.rows - 1 ? bitboard.head + offset + bitboard.words
+                                  : bitboard.zeroRow;
+
+        for (int w = 0; w < bitboard.words; w++) {
+            uint64_t aw, ac, ae, mw, mc, me, bw, bc, be;
+            ShiftedHeads(above, w, &aw, &ac, &ae);
+            ShiftedHeads(middle, w, &mw, &mc, &me);
+            ShiftedHeads(below, w, &bw, &bc, &be);
+            (void)mc;
+
+            // Add the three rows separately: each row sum is a 2-bit number.
+            uint64_t a0 = aw ^ ac ^ ae;
+            uint64_t a1 = (aw & ac) | (ae & (aw ^ ac));
+            uint64_t b0 = bw ^ bc ^ be;
+            uint64_t b1 = (bw & bc) | (be & (bw ^ bc));
+            uint64_t m0 = mw ^ me;
+            uint64_t m1 = mw & me;
+
+            // Fold the ones column; its carry joins the twos column.
+            uint64_t ones = a0 ^ b0 ^ m0;
+            uint64_t carry = (a0 & b0) | (m0 & (a0 ^ b0));
+
+            // The count is 1 or 2 when there is a single one and no twos,
+            // or no ones and exactly one of the four twos.
+            uint64_t anyTwo = a1 | b1 | m1 | carry;
+            uint64_t oddTwos = a1 ^ b1 ^ m1 ^ carry;
+            uint64_t manyTwos =
+                ((a1 | b1) & (m1 | carry)) | (a1 & b1) | (m1 & carry);
+            uint64_t oneTwo = oddTwos & ~manyTwos;
+            uint64_t fires = (ones & ~anyTwo) | (~ones & oneTwo);
+
+            size_t i = offset + w;
+            uint64_t conductor = bitboard.conductor[i];
+            bitboard.nextHead[i] = conductor & fires;
+            bitboard.nextTail[i] = bitboard.head[i];
+            bitboard.nextConductor[i] = bitboard.tail[i] | (conductor & ~fires);
+        }
+    }
+
+    uint64_t* swap = bitboard.head;
+    bitboard.head = bitboard.nextHead;
+    bitboard.nextHead = swap;
+    swap = bitboard.tail;
+    bitboard.tail = bitboard.nextTail;
+    bitboard.nextTail = swap;
+    swap = bitboard.conductor;
+    bitboard.conductor = bitboard.nextConductor;
+    bitboard.nextConductor = swap;
+}
+
+void FreeBitboard(void) {
+    RL_FREE(bitboard.storage);
+    bitboard = (Bitboard){0};
+}
+
+void StepBitboard(int generations) {
+    ResizeBitboard(grid.rows, grid.cols);
+    PackBitboard();
+    for (int i = 0; i < generations; i++) {
+        UpdateBitboard();
+    }
+    UnpackBitboard();
+    grid.version++;
+}
+
+// SIMD engine: rows are updated by a vector kernel picked at startup from
+// what the CPU supports. The grid halo lets the kernels read the rows above
+// and below and one cell past either end of a row unconditionally.
+//
+// Kernels return which 64-cell blocks of what they wrote hold a head or a
+// tail: bit i covers [start + 64 i, start + 64 i + 64), and bit 63 also
+// everything after it.
+typedef uint64_t (*RowKernel)(const Cell* above, const Cell* row,
+                              const Cell* below, Cell* out, int start,
+                              int end);
+
+uint64_t ElectronBlock(bool electrons, int offset) {
+    int block = offset / 64;
+    return (uint64_t)electrons << (block < 63 ? block : 63);
+}
+
+uint64_t UpdateRowScalar(const Cell* above, const Cell* row,
+                         const Cell* below, Cell* out, int start, int end) {
+    uint64_t electrons = 0;
+    for (int x = start; x < end; x++) {
+        int heads = (above[x - 1] == HEAD) + (above[x] == HEAD) +
+                    (above[x + 1] == HEAD) + (row[x - 1] == HEAD) +
+                    (row[x + 1] == HEAD) + (below[x - 1] == HEAD) +
+                    (below[x] == HEAD) + (below[x + 1] == HEAD);
+        Cell cell = row[x];
+        int fires = cell == CONDUCTOR && (heads == 1 || heads == 2);
+        out[x] = cell + (cell == HEAD) + fires - 2 * (cell == TAIL);
+        electrons |= ElectronBlock(out[x] >= HEAD, x - start);
+    }
+    return electrons;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+// The vector kernels count heads as a sum of all-ones compare masks, so a
+// cell with one or two head neighbours ends up with a count of -1 or -2.
+__attribute__((target("sse2"))) uint64_t UpdateRowSse2(const Cell* above,
+                                                       const Cell* row,
+                                                       const Cell* below,
+                                                       Cell* out, int start,
+                                                       int end) {
+    const __m128i head = _mm_set1_epi8(HEAD);
+    const __m128i tail = _mm_set1_epi8(TAIL);
+    const __m128i conductor = _mm_set1_epi8(CONDUCTOR);
+    const __m128i one = _mm_set1_epi8(-1);
+    const __m128i two = _mm_set1_epi8(-2);
+    uint64_t electrons = 0;
+
+    int x = start;
+    for (; x + 16 <= end; x += 16) {
+        __m128i count = _mm_setzero_si128();
+        const Cell* rows[3] = {above, row, below};
+        for (int r = 0; r < 3; r++) {
+            const Cell* p = rows[r] + x;
+            count = _mm_add_epi8(
+                count, _mm_cmpeq_epi8(_mm_loadu_si128((const void*)(p - 1)),
+                                      head));
+            if (r != 1)
+                count = _mm_add_epi8(
+                    count,
+                    _mm_cmpeq_epi8(_mm_loadu_si128((const void*)p), head));
+            count = _mm_add_epi8(
+                count, _mm_cmpeq_epi8(_mm_loadu_si128((const void*)(p + 1)),
+                                      head));
+        }
+
+        __m128i cell = _mm_loadu_si128((const void*)(row + x));
+        __m128i isHead = _mm_cmpeq_epi8(cell, head);
+        __m128i isTail = _mm_cmpeq_epi8(cell, tail);
+        __m128i fires = _mm_and_si128(
+            _mm_cmpeq_epi8(cell, conductor),
+            _mm_or_si128(_mm_cmpeq_epi8(count, one),
+                         _mm_cmpeq_epi8(count, two)));
+        __m128i next = _mm_sub_epi8(cell, _mm_add_epi8(isHead, fires));
+        next = _mm_sub_epi8(next, _mm_and_si128(isTail, _mm_set1_epi8(2)));
+        _mm_storeu_si128((void*)(out + x), next);
+        electrons |= ElectronBlock(
+            _mm_movemask_epi8(_mm_cmpgt_epi8(next, conductor)), x - start);
+    }
+    // The tail never crosses into another 64-cell block.
+    return electrons |
+           ElectronBlock(UpdateRowScalar(above, row, below, out, x, end),
+                         x - start);
+}
+
+__attribute__((target("avx2"))) uint64_t UpdateRowAvx2(const Cell* above,
+                                                       const Cell* row,
+                                                       const Cell* below,
+                                                       Cell* out, int start,
+                                                       int end) {
+    const __m256i head = _mm256_set1_epi8(HEAD);
+    const __m256i tail = _mm256_set1_epi8(TAIL);
+    const __m256i conductor = _mm256_set1_epi8(CONDUCTOR);
+    const __m256i one = _mm256_set1_epi8(-1);
+    const __m256i two = _mm256_set1_epi8(-2);
+    uint64_t electrons = 0;
+
+    int x = start;
+    for (; x + 32 <= end; x += 32) {
+        __m256i count = _mm256_setzero_si256();
+        const Cell* rows[3] = {above, row, below};
+        for (int r = 0; r < 3; r++) {
+            const Cell* p = rows[r] + x;
+            count = _mm256_add_epi8(
+                count,
+                _mm256_cmpeq_epi8(
+                    _mm256_loadu_si256((const void*)(p - 1)), head));
+            if (r != 1)
+                count = _mm256_add_epi8(
+                    count, _mm256_cmpeq_epi8(
+                               _mm256_loadu_si256((const void*)p), head));
+            count = _mm256_add_epi8(
+                count,
+                _mm256_cmpeq_epi8(
+                    _mm256_loadu_si256((const void*)(p + 1)), head));
+        }
+
+        __m256i cell = _mm256_loadu_si256((const void*)(row + x));
+        __m256i isHead = _mm256_cmpeq_epi8(cell, head);
+        __m256i isTail = _mm256_cmpeq_epi8(cell, tail);
+        __m256i fires = _mm256_and_si256(
+            _mm256_cmpeq_epi8(cell, conductor),
+            _mm256_or_si256(_mm256_cmpeq_epi8(count, one),
+                            _mm256_cmpeq_epi8(count, two)));
+        __m256i next = _mm256_sub_epi8(cell, _mm256_add_epi8(isHead, fires));
+        next = _mm256_sub_epi8(next,
+                               _mm256_and_si256(isTail, _mm256_set1_epi8(2)));
+        _mm256_storeu_si256((void*)(out + x), next);
+        electrons |= ElectronBlock(
+            _mm256_movemask_epi8(_mm256_cmpgt_epi8(next, conductor)),
+            x - start);
+    }
+    return electrons |
+           ElectronBlock(UpdateRowScalar(above, row, below, out, x, end),
+                         x - start);
+}
+
+__attribute__((target("avx512bw"))) uint64_t
+UpdateRowAvx512(const Cell* above, const Cell* row, const Cell* below,
+                Cell* out, int start, int end) {
+    const __m512i head = _mm512_set1_epi8(HEAD);
+    const __m512i one = _mm512_set1_epi8(1);
+    const __m512i two = _mm512_set1_epi8(2);
+    uint64_t electrons = 0;
+
+    int x = start;
+    for (; x + 64 <= end; x += 64) {
+        __m512i count = _mm512_setzero_si512();
+        const Cell* rows[3] = {above, row, below};
+        for (int r = 0; r < 3; r++) {
+            const Cell* p = rows[r] + x;
+            __mmask64 west = _mm512_cmpeq_epi8_mask(
+                _mm512_loadu_si512((const void*)(p - 1)), head);
+            __mmask64 east = _mm512_cmpeq_epi8_mask(
+                _mm512_loadu_si512((const void*)(p + 1)), head);
+            count = _mm512_mask_add_epi8(count, west, count, one);
+            count = _mm512_mask_add_epi8(count, east, count, one);
+            if (r != 1) {
+                __mmask64 centre = _mm512_cmpeq_epi8_mask(
+                    _mm512_loadu_si512((const void*)p), head);
+                count = _mm512_mask_add_epi8(count, centre, count, one);
+            }
+        }
+
+        __m512i cell = _mm512_loadu_si512((const void*)(row + x));
+        __mmask64 isHead = _mm512_cmpeq_epi8_mask(cell, head);
+        __mmask64 isTail =
+            _mm512_cmpeq_epi8_mask(cell, _mm512_set1_epi8(TAIL));
+        __mmask64 fires =
+            _mm512_cmpeq_epi8_mask(cell, _mm512_set1_epi8(CONDUCTOR)) &
+            (_mm512_cmpeq_epi8_mask(count, one) |
+             _mm512_cmpeq_epi8_mask(count, two));
+        __m512i next = _mm512_mask_add_epi8(cell, isHead | fires, cell, one);
+        next = _mm512_mask_sub_epi8(next, isTail, next, two);
+        _mm512_storeu_si512((void*)(out + x), next);
+        electrons |= ElectronBlock(
+            _mm512_cmpgt_epi8_mask(next, _mm512_set1_epi8(CONDUCTOR)),
+            x - start);
+    }
+    return electrons |
+           ElectronBlock(UpdateRowScalar(above, row, below, out, x, end),
+                         x - start);
+}
+#endif
+
+typedef struct {
+    const char* name;
+    RowKernel kernel;
+} SimdKernel;
+
+SimdKernel simdKernel = {NULL, NULL};
+
+void SelectSimdKernel(void) {
+    simdKernel = (SimdKernel){"scalar", UpdateRowScalar};
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512bw")) {
+        simdKernel = (SimdKernel){"avx512", UpdateRowAvx512};
+    } else if (__builtin_cpu_supports("avx2")) {
+        simdKernel = (SimdKernel){"avx2", UpdateRowAvx2};
+    } else if (__builtin_cpu_supports("sse2")) {
+        simdKernel = (SimdKernel){"sse2", UpdateRowSse2};
+    }
+#endif
+}
+
+void PrepareSimd(void) {
+    if (!simdKernel.kernel)
+        SelectSimdKernel();
+}
+
+// Writes rows [startRow, endRow) and columns [startCol, endCol) of the next
+// generation into grid.nextCells. Returns the 64-column blocks that hold
+// electrons, as the kernels do.
+uint64_t UpdateRegionSimd(int startRow, int endRow, int startCol,
+                          int endCol) {
+    uint64_t electrons = 0;
+    for (int y = startRow; y < endRow; y++) {
+        const Cell* row = &grid.cells[(size_t)y * grid.stride];
+        Cell* newRow = &grid.nextCells[(size_t)y * grid.stride];
+        electrons |= simdKernel.kernel(row - grid.stride, row,
+                                       row + grid.stride, newRow, startCol,
+                                       endCol);
+    }
+    return electrons;
+}
+
+void UpdateRowsSimd(int startRow, int endRow) {
+    UpdateRegionSimd(startRow, endRow, 0, grid.cols);
+}
+
+void UpdateGridSimd(void) {
+    PrepareSimd();
+    UpdateRowsSimd(0, grid.rows);
+    SwapGrid();
+}
+
+void StepSimd(int generations) {
+    for (int i = 0; i < generations; i++) {
+        UpdateGridSimd();
+    }
+    grid.version++;
+}
+
+// Persistent worker pool. The calling thread acts as worker 0, and every
+// RunPool call is bracketed by two barriers so all workers finish a job
+// before the caller moves on to the next generation.
+typedef void (*PoolJob)(int worker, int workerCount);
+
+typedef struct {
+    pthread_t* threads;
+    int workerCount;
+    pthread_barrier_t start;
+    pthread_barrier_t done;
+    PoolJob job;
+    bool quit;
+} ThreadPool;
+
+ThreadPool pool = {0};
+int threadCount = 0;  // 0 means one worker per online CPU
+
+void* PoolWorker(void* arg) {
+    int worker = (int)(intptr_t)arg;
+    for (;;) {
+        pthread_barrier_wait(&pool.start);
+        if (pool.quit)
+            break;
+        pool.job(worker, pool.workerCount);
+        pthread_barrier_wait(&pool.done);
+    }
+    return NULL;
+}
+
+void StartPool(void) {
+    int workerCount = threadCount;
+    if (workerCount <= 0)
+        workerCount = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (workerCount <= 0)
+        workerCount = 1;
+
+    pool.workerCount = workerCount;
+    pool.quit = false;
+    pthread_barrier_init(&pool.start, NULL, workerCount);
+    pthread_barrier_init(&pool.done, NULL, workerCount);
+    pool.threads = CheckedCalloc(workerCount, sizeof(pthread_t));
+    for (int i = 1; i < workerCount; i++) {
+        pthread_create(&pool.threads[i], NULL, PoolWorker, (void*)(intptr_t)i);
+    }
+}
+
+void RunPool(PoolJob job) {
+    if (!pool.threads)
+        StartPool();
+
+    pool.job = job;
+    pthread_barrier_wait(&pool.start);
+    job(0, pool.workerCount);
+    pthread_barrier_wait(&pool.done);
+}
+
+void StopPool(void) {
+    if (!pool.threads)
+        return;
+
+    pool.quit = true;
+    pthread_barrier_wait(&pool.start);
+    for (int i = 1; i < pool.workerCount; i++) {
+        pthread_join(pool.threads[i], NULL);
+    }
+    pthread_barrier_destroy(&pool.start);
+    pthread_barrier_destroy(&pool.done);
+    RL_FREE(pool.threads);
+    pool = (ThreadPool){0};
+}
+
+// Threaded engine: each worker runs the SIMD row kernel over its own band
+// of rows.
+void UpdateBand(int worker, int workerCount) {
+    int startRow = (int)((long)grid.rows * worker / workerCount);
+    int endRow = (int)((long)grid.rows * (worker + 1) / workerCount);
+    UpdateRowsSimd(startRow, endRow);
+}
+
+void StepThreaded(int generations) {
+    PrepareSimd();
+    for (int i = 0; i < generations; i++) {
+        RunPool(UpdateBand);
+        SwapGrid();
+    }
+    grid.version++;
+}
+
+// Tiled engine: the grid is cut into tileSize x tileSize tiles. A tile with
+// no heads or tails in itself or its eight neighbours cannot change, so only
+// tiles near electrons are scheduled. Neighbouring tiles in a row of tiles
+// are computed together, one kernel call per cell row, since a call per
+// row of a single tile costs more than the cells in it. The kernels report
+// electrons per 64 cells, which is one tile. Scheduled runs are dealt out
+// to one deque per worker; a worker that runs dry steals from the others.
+const int tileSize = 64;
+const int maxTileRun = 16;
+
+typedef struct {
+    int* tasks;
+    int top;     // thieves take from here
+    int bottom;  // the owner pops from here
+    pthread_mutex_t lock;
+} TaskDeque;
+
+typedef struct {
+    unsigned long version;  // grid.version the flags were built from
+    int tilesX;
+    int tilesY;
+    uint8_t* flags;
+    uint8_t* active;      // tile has a head or tail in this generation
+    uint8_t* nextActive;  // same, for the generation being computed
+    uint8_t* synced;      // back buffer already equals the front for the tile
+    uint8_t* compute;     // tile is recomputed this generation
+    uint8_t* runs;        // tiles in the task starting at the tile
+    int* tasks;
+    int taskCount;
+    TaskDeque* deques;
+    int dequeCount;
+} TileScheduler;
+
+TileScheduler tiles = {0};
+
+bool RegionHasElectrons(const Cell* cells, int startRow, int endRow,
+                        int startCol, int endCol) {
+    Cell any = 0;
+    for (int y = startRow; y < endRow; y++) {
+        const Cell* row = &cells[(size_t)y * grid.stride];
+        for (int x = startCol; x < endCol; x++) {
+            any |= row[x] >= HEAD;
+        }
+    }
+    return any;
+}
+
+void TileBounds(int tile, int* startRow, int* endRow, int* startCol,
+                int* endCol) {
+    int tileX = tile % tiles.tilesX;
+    int tileY = tile / tiles.tilesX;
+    *startRow = tileY * tileSize;
+    *startCol = tileX * tileSize;
+    *endRow = *startRow + tileSize < grid.rows ? *startRow + tileSize
+                                               : grid.rows;
+    *endCol = *startCol + tileSize < grid.cols ? *startCol + tileSize
+                                               : grid.cols;
+}
+
+void BuildTiles(void) {
+    int tilesX = (grid.cols + tileSize - 1) / tileSize;
+    int tilesY = (grid.rows + tileSize - 1) / tileSize;
+    if (tiles.tilesX != tilesX || tiles.tilesY != tilesY) {
+        int count = tilesX * tilesY;
+        RL_FREE(tiles.flags);
+        RL_FREE(tiles.tasks);
+        tiles.flags = CheckedCalloc(count * 5, sizeof(uint8_t));
+        tiles.active = tiles.flags;
+        tiles.nextActive = tiles.active + count;
+        tiles.synced = tiles.nextActive + count;
+        tiles.compute = tiles.synced + count;
+        tiles.runs = tiles.compute + count;
+        tiles.tasks = CheckedCalloc(count, sizeof(int));
+        tiles.tilesX = tilesX;
+        tiles.tilesY = tilesY;
+        for (int i = 0; i < tiles.dequeCount; i++) {
+            RL_FREE(tiles.deques[i].tasks);
+            tiles.deques[i].tasks = CheckedCalloc(count, sizeof(int));
+        }
+    }
+
+    for (int tile = 0; tile < tilesX * tilesY; tile++) {
+        int startRow, endRow, startCol, endCol;
+        TileBounds(tile, &startRow, &endRow, &startCol, &endCol);
+        tiles.active[tile] = RegionHasElectrons(grid.cells, startRow, endRow,
+                                                startCol, endCol);
+        tiles.synced[tile] = false;
+    }
+    tiles.version = grid.version;
+}
+
+void StartDeques(int workerCount) {
+    if (tiles.dequeCount == workerCount)
+        return;
+
+    tiles.deques = CheckedCalloc(workerCount, sizeof(TaskDeque));
+    for (int i = 0; i < workerCount; i++) {
+        tiles.deques[i].tasks =
+            CheckedCalloc(tiles.tilesX * tiles.tilesY, sizeof(int));
+        pthread_mutex_init(&tiles.deques[i].lock, NULL);
+    }
+    tiles.dequeCount = workerCount;
+}
+
+bool PopTask(TaskDeque* deque, int* task) {
+    pthread_mutex_lock(&deque->lock);
+    bool found = deque->bottom > deque->top;
+    if (found)
+        *task = deque->tasks[--deque->bottom];
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+bool StealTask(TaskDeque* deque, int* task) {
+    pthread_mutex_lock(&deque->lock);
+    bool found = deque->bottom > deque->top;
+    if (found)
+        *task = deque->tasks[deque->top++];
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+void RunTile(int tile) {
+    int startRow, endRow, startCol, endCol;
+    TileBounds(tile, &startRow, &endRow, &startCol, &endCol);
+
+    if (tiles.compute[tile]) {
+        int run = tiles.runs[tile];
+        if (startCol + run * tileSize < grid.cols)
+            endCol = startCol + run * tileSize;
+        else
+            endCol = grid.cols;
+        uint64_t electrons =
+            UpdateRegionSimd(startRow, endRow, startCol, endCol);
+        for (int i = 0; i < run; i++) {
+            tiles.nextActive[tile + i] = electrons >> i & 1;
+        }
+    } else {
+        for (int y = startRow; y < endRow; y++) {
+            size_t offset = (size_t)y * grid.stride + startCol;
+            memcpy(&grid.nextCells[offset], &grid.cells[offset],
+                   (endCol - startCol) * sizeof(Cell));
+        }
+        tiles.nextActive[tile] = false;
+    }
+}
+
+void UpdateTiles(int worker, int workerCount) {
+    int task;
+    while (PopTask(&tiles.deques[worker], &task)) {
+        RunTile(task);
+    }
+    for (int i = 1; i < workerCount; i++) {
+        TaskDeque* victim = &tiles.deques[(worker + i) % workerCount];
+        while (StealTask(victim, &task)) {
+            RunTile(task);
+        }
+    }
+}
+
+void ScheduleTiles(void) {
+    tiles.taskCount = 0;
+    for (int tileY = 0; tileY < tiles.tilesY; tileY++) {
+        for (int tileX = 0; tileX < tiles.tilesX; tileX++) {
+            int tile = tileY * tiles.tilesX + tileX;
+            bool compute = false;
+            for (int y = tileY - 1; y <= tileY + 1; y++) {
+                for (int x = tileX - 1; x <= tileX + 1; x++) {
+                    if (y >= 0 && y < tiles.tilesY && x >= 0 &&
+                        x < tiles.tilesX &&
+                        tiles.active[y * tiles.tilesX + x]) {
+                        compute = true;
+                    }
+                }
+            }
+            tiles.compute[tile] = compute;
+            tiles.nextActive[tile] = false;
+        }
+
+        for (int tileX = 0; tileX < tiles.tilesX; tileX++) {
+            int tile = tileY * tiles.tilesX + tileX;
+            if (!tiles.compute[tile] && tiles.synced[tile])
+                continue;
+            int run = 1;
+            while (tiles.compute[tile] && run < maxTileRun &&
+                   tileX + run < tiles.tilesX && tiles.compute[tile + run])
+                run++;
+            tiles.runs[tile] = run;
+            tiles.tasks[tiles.taskCount++] = tile;
+            tileX += run - 1;
+        }
+    }
+
+    // Deal contiguous runs of tasks so each worker starts on nearby tiles.
+    for (int i = 0; i < tiles.dequeCount; i++) {
+        TaskDeque* deque = &tiles.deques[i];
+        int start = (int)((long)tiles.taskCount * i / tiles.dequeCount);
+        int end = (int)((long)tiles.taskCount * (i + 1) / tiles.dequeCount);
+        memcpy(deque->tasks, &tiles.tasks[start], (end - start) * sizeof(int));
+        deque->top = 0;
+        deque->bottom = end - start;
+    }
+}
+
+void UpdateGridTiled(void) {
+    ScheduleTiles();
+    RunPool(UpdateTiles);
+
+    for (int tile = 0; tile < tiles.tilesX * tiles.tilesY; tile++) {
+        if (tiles.compute[tile]) {
+            // The back buffer now holds the previous generation of the tile,
+            // which only matches if nothing in it changed.
+            tiles.synced[tile] = !tiles.active[tile] && !tiles.nextActive[tile];
+        } else {
+            tiles.synced[tile] = true;
+        }
+    }
+
+    uint8_t* active = tiles.active;
+    tiles.active = tiles.nextActive;
+    tiles.nextActive = active;
+    SwapGrid();
+}
+
+void StepTiled(int generations) {
+    PrepareSimd();
+    if (!pool.threads)
+        StartPool();
+    if (tiles.version != grid.version || !tiles.active)
+        BuildTiles();
+    StartDeques(pool.workerCount);
+
+    for (int i = 0; i < generations; i++) {
+        UpdateGridTiled();
+    }
+    grid.version++;
+    tiles.version = grid.version;
+}
+
+void FreeTiled(void) {
+    StopPool();
+    for (int i = 0; i < tiles.dequeCount; i++) {
+        RL_FREE(tiles.deques[i].tasks);
+        pthread_mutex_destroy(&tiles.deques[i].lock);
+    }
+    RL_FREE(tiles.deques);
+    RL_FREE(tiles.flags);
+    RL_FREE(tiles.tasks);
+    tiles = (TileScheduler){0};
+}
+
+// HashLife engine: the grid is turned into a quadtree of hash-consed nodes,
+// and the future of every node's centre is memoized. A level k node
+// (2^k x 2^k cells) can be advanced up to 2^(k-2) generations at once,
+// and identical regions share one node, so repetitive circuits take little
+// memory and long runs reuse results they have already computed.
+typedef struct {
+    uint32_t nw, ne, sw, se;  // children; a leaf keeps its Cell in nw
+    uint32_t result;          // memoized centre after 2^resultStep gens
+    uint32_t next;            // next node in the same hash bucket
+    uint8_t level;
+    uint8_t resultStep;
+} QuadNode;
+
+typedef struct {
+    QuadNode* nodes;  // node 0 is unused so that 0 can mean "none"
+    uint32_t nodeCount;
+    uint32_t nodeCapacity;
+    uint32_t* buckets;
+    uint32_t bucketCount;  // always a power of two
+    uint32_t emptyNodes[64];
+    int step;  // generations per Advance is 2^step, capped by node level
+} QuadTree;
+
+QuadTree quadTree = {0};
+
+const uint32_t quadTreeMaxNodes = 1u << 22;
+
+uint32_t HashQuad(uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se) {
+    uint32_t hash = nw * 0x9E3779B1u + ne * 0x85EBCA77u + sw * 0xC2B2AE3Du +
+                    se * 0x27D4EB2Fu;
+    return hash ^ (hash >> 15);
+}
+
+uint32_t AddQuadNode(QuadNode node) {
+    if (quadTree.nodeCount == quadTree.nodeCapacity) {
+        quadTree.nodeCapacity *= 2;
+        quadTree.nodes = CheckedRealloc(
+            quadTree.nodes, quadTree.nodeCapacity * sizeof(QuadNode));
+    }
+    quadTree.nodes[quadTree.nodeCount] = node;
+    return quadTree.nodeCount++;
+}
+
+void RehashQuadTree(void) {
+    quadTree.bucketCount *= 2;
+    RL_FREE(quadTree.buckets);
+    quadTree.buckets = CheckedCalloc(quadTree.bucketCount, sizeof(uint32_t));
+    for (uint32_t id = 1; id < quadTree.nodeCount; id++) {
+        QuadNode* node = &quadTree.nodes[id];
+        if (node->level == 0)
+            continue;
+        uint32_t bucket = HashQuad(node->nw, node->ne, node->sw, node->se) &
+                          (quadTree.bucketCount - 1);
+        node->next = quadTree.buckets[bucket];
+        quadTree.buckets[bucket] = id;
+    }
+}
+
+void InitQuadTree(void) {
+    quadTree.nodeCapacity = 1 << 16;
+    quadTree.nodes = CheckedMalloc(quadTree.nodeCapacity * sizeof(QuadNode));
+    quadTree.nodeCount = 1;
+    quadTree.bucketCount = 1 << 16;
+    quadTree.buckets = CheckedCalloc(quadTree.bucketCount, sizeof(uint32_t));
+    memset(quadTree.emptyNodes, 0, sizeof(quadTree.emptyNodes));
+
+    // Leaves for EMPTY, CONDUCTOR, HEAD and TAIL get ids 1 to 4.
+    for (Cell cell = EMPTY; cell <= TAIL; cell++) {
+        AddQuadNode((QuadNode){cell, 0, 0, 0, 0, 0, 0, 0});
+    }
+    quadTree.emptyNodes[0] = 1 + EMPTY;
+}
+
+void FreeQuadTree(void) {
+    RL_FREE(quadTree.nodes);
+    RL_FREE(quadTree.buckets);
+    quadTree = (QuadTree){0};
+}
+
+uint32_t LeafNode(Cell cell) {
+    return 1 + cell;
+}
+
+uint32_t JoinQuad(uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se) {
+    uint32_t bucket = HashQuad(nw, ne, sw, se) & (quadTree.bucketCount - 1);
+    for (uint32_t id = quadTree.buckets[bucket]; id;
+         id = quadTree.nodes[id].next) {
+        QuadNode* node = &quadTree.nodes[id];
+        if (node->nw == nw && node->ne == ne && node->sw == sw &&
+            node->se == se)
+            return id;
+    }
+
+    uint8_t level = quadTree.nodes[nw].level + 1;
+    uint32_t id = AddQuadNode((QuadNode){nw, ne, sw, se, 0,
+                                         quadTree.buckets[bucket], level, 0});
+    quadTree.buckets[bucket] = id;
+    if (quadTree.nodeCount > quadTree.bucketCount)
+        RehashQuadTree();
+    return id;
+}
+
+uint32_t EmptyQuad(int level) {
+    if (!quadTree.emptyNodes[level]) {
+        uint32_t child = EmptyQuad(level - 1);
+        quadTree.emptyNodes[level] = JoinQuad(child, child, child, child);
+    }
+    return quadTree.emptyNodes[level];
+}
+
+uint32_t CentreQuad(uint32_t id) {
+    QuadNode node = quadTree.nodes[id];
+    return JoinQuad(quadTree.nodes[node.nw].se, quadTree.nodes[node.ne].sw,
+                    quadTree.nodes[node.sw].ne, quadTree.nodes[node.se].nw);
+}
+
+// Level 2 base case: the centre 2x2 of a 4x4 block after one generation.
+uint32_t AdvanceQuadBase(uint32_t id) {
+    QuadNode node = quadTree.nodes[id];
+    uint32_t quadrants[4] = {node.nw, node.ne, node.sw, node.se};
+    Cell cells[4][4];
+    for (int q = 0; q < 4; q++) {
+        QuadNode quadrant = quadTree.nodes[quadrants[q]];
+        int y = (q / 2) * 2;
+        int x = (q % 2) * 2;
+        cells[y][x] = quadTree.nodes[quadrant.nw].nw;
+        cells[y][x + 1] = quadTree.nodes[quadrant.ne].nw;
+        cells[y + 1][x] = quadTree.nodes[quadrant.sw].nw;
+        cells[y + 1][x + 1] = quadTree.nodes[quadrant.se].nw;
+    }
+
+    uint32_t next[4];
+    for (int i = 0; i < 4; i++) {
+        int row = 1 + i / 2;
+        int col = 1 + i % 2;
+        Cell cell = cells[row][col];
+        int heads = 0;
+        for (int y = -1; y <= 1; y++) {
+            for (int x = -1; x <= 1; x++) {
+                heads += (y != 0 || x != 0) && cells[row + y][col + x] == HEAD;
+            }
+        }
+        switch (cell) {
+            case HEAD:
+                cell = TAIL;
+                break;
+            case TAIL:
+                cell = CONDUCTOR;
+                break;
+            case CONDUCTOR:
+                cell = heads == 1 || heads == 2 ? HEAD : CONDUCTOR;
+                break;
+        }
+        next[i] = LeafNode(cell);
+    }
+    return JoinQuad(next[0], next[1], next[2], next[3]);
+}
+
+// Returns the centre of a level k node advanced 2^min(step, k - 2)
+// generations, as a level k - 1 node.
+uint32_t AdvanceQuad(uint32_t id) {
+    QuadNode node = quadTree.nodes[id];
+    int step = quadTree.step < node.level - 2 ? quadTree.step : node.level - 2;
+    if (node.result && node.resultStep == step)
+        return node.result;
+    if (id == EmptyQuad(node.level))
+        return EmptyQuad(node.level - 1);
+
+    uint32_t result;
+    if (node.level == 2) {
+        result = AdvanceQuadBase(id);
+    } else {
+        QuadNode nw = quadTree.nodes[node.nw];
+        QuadNode ne = quadTree.nodes[node.ne];
+        QuadNode sw = quadTree.nodes[node.sw];
+        QuadNode se = quadTree.nodes[node.se];
+
+        // Nine overlapping sub-squares, each advanced on its own.
+        uint32_t n00 = AdvanceQuad(node.nw);
+        uint32_t n01 = AdvanceQuad(JoinQuad(nw.ne, ne.nw, nw.se, ne.sw));
+        uint32_t n02 = AdvanceQuad(node.ne);
+        uint32_t n10 = AdvanceQuad(JoinQuad(nw.sw, nw.se, sw.nw, sw.ne));
+        uint32_t n11 = AdvanceQuad(JoinQuad(nw.se, ne.sw, sw.ne, se.nw));
+        uint32_t n12 = AdvanceQuad(JoinQuad(ne.sw, ne.se, se.nw, se.ne));
+        uint32_t n20 = AdvanceQuad(node.sw);
+        uint32_t n21 = AdvanceQuad(JoinQuad(sw.ne, se.nw, sw.se, se.sw));
+        uint32_t n22 = AdvanceQuad(node.se);
+
+        uint32_t quads[4] = {JoinQuad(n00, n01, n10, n11),
+                             JoinQuad(n01, n02, n11, n12),
+                             JoinQuad(n10, n11, n20, n21),
+                             JoinQuad(n11, n12, n21, n22)};
+        // At full speed the four quadrants are advanced a second time,
+        // otherwise their centres already are 2^step generations ahead.
+        for (int i = 0; i < 4; i++) {
+            quads[i] = step == node.level - 2 ? AdvanceQuad(quads[i])
+                                              : CentreQuad(quads[i]);
+        }
+        result = JoinQuad(quads[0], quads[1], quads[2], quads[3]);
+    }
+
+    quadTree.nodes[id].result = result;
+    quadTree.nodes[id].resultStep = step;
+    return result;
+}
+
+// Builds the node whose top-left cell is at grid column x, row y; cells
+// outside the grid are EMPTY.
+uint32_t BuildQuad(int level, long long x, long long y) {
+    long long size = 1LL << level;
+    if (x >= grid.cols || y >= grid.rows || x + size <= 0 || y + size <= 0)
+        return EmptyQuad(level);
+    if (level == 0)
+        return LeafNode(GetCell(y, x));
+
+    long long half = size / 2;
+    return JoinQuad(BuildQuad(level - 1, x, y),
+                    BuildQuad(level - 1, x + half, y),
+                    BuildQuad(level - 1, x, y + half),
+                    BuildQuad(level - 1, x + half, y + half));
+}
+
+void WriteQuad(uint32_t id, long long x, long long y) {
+    QuadNode node = quadTree.nodes[id];
+    long long size = 1LL << node.level;
+    if (x >= grid.cols || y >= grid.rows || x + size <= 0 || y + size <= 0 ||
+        id == EmptyQuad(node.level))
+        return;
+    if (node.level == 0) {
+        grid.cells[(size_t)y * grid.stride + x] = node.nw;
+        return;
+    }
+
+    long long half = size / 2;
+    WriteQuad(node.nw, x, y);
+    WriteQuad(node.ne, x + half, y);
+    WriteQuad(node.sw, x, y + half);
+    WriteQuad(node.se, x + half, y + half);
+}
+
+// Advances the grid by 2^exponent generations.
+void JumpQuadTree(int exponent) {
+    if (quadTree.nodeCount > quadTreeMaxNodes)
+        FreeQuadTree();
+    if (!quadTree.nodes)
+        InitQuadTree();
+
+    int size = grid.rows > grid.cols ? grid.rows : grid.cols;
+    int gridLevel = 2;
+    while ((1LL << gridLevel) < size) {
+        gridLevel++;
+    }
+
+    // Centre the grid in a root big enough for the jump; since the result
+    // is the centre half of the root, it starts at grid cell (0, 0).
+    int level = gridLevel + 1 > exponent + 2 ? gridLevel + 1 : exponent + 2;
+    long long offset = 1LL << (level - 2);
+    quadTree.step = exponent;
+    uint32_t root = BuildQuad(level, -offset, -offset);
+    uint32_t result = AdvanceQuad(root);
+
+    memset(grid.cells, 0, (size_t)grid.rows * grid.stride * sizeof(Cell));
+    WriteQuad(result, 0, 0);
+    grid.version++;
+}
+
+void StepHashLife(int generations) {
+    for (int bit = 30; bit >= 0; bit--) {
+        if (generations & (1 << bit))
+            JumpQuadTree(bit);
+    }
+}
+
+// Boards too spread out for the grid are advanced straight from their
+// chunks: each chunk becomes a level chunkLevel node placed into an EMPTY
+// root, so the tree, like the chunks, only covers the circuit.
+uint32_t BuildChunkQuad(const Chunk* chunk, int level, int x, int y) {
+    if (level == 0)
+        return LeafNode(ChunkRow(chunk, y)[x]);
+
+    int half = 1 << (level - 1);
+    return JoinQuad(BuildChunkQuad(chunk, level - 1, x, y),
+                    BuildChunkQuad(chunk, level - 1, x + half, y),
+                    BuildChunkQuad(chunk, level - 1, x, y + half),
+                    BuildChunkQuad(chunk, level - 1, x + half, y + half));
+}
+
+void WriteChunkQuad(uint32_t id, const Chunk* chunk, int x, int y) {
+    QuadNode node = quadTree.nodes[id];
+    if (id == EmptyQuad(node.level))
+        return;
+    if (node.level == 0) {
+        ChunkRow(chunk, y)[x] = node.nw;
+        return;
+    }
+
+    int half = 1 << (node.level - 1);
+    WriteChunkQuad(node.nw, chunk, x, y);
+    WriteChunkQuad(node.ne, chunk, x + half, y);
+    WriteChunkQuad(node.sw, chunk, x, y + half);
+    WriteChunkQuad(node.se, chunk, x + half, y + half);
+}
+
+// Returns the node with part, a node of a lower level, replacing what is at
+// x, y inside it.
+uint32_t PlaceQuad(uint32_t id, long long x, long long y, uint32_t part) {
+    QuadNode node = quadTree.nodes[id];
+    if (node.level == quadTree.nodes[part].level)
+        return part;
+
+    long long half = 1LL << (node.level - 1);
+    uint32_t children[4] = {node.nw, node.ne, node.sw, node.se};
+    int quadrant = (y >= half) * 2 + (x >= half);
+    children[quadrant] = PlaceQuad(children[quadrant], x % half, y % half,
+                                   part);
+    return JoinQuad(children[0], children[1], children[2], children[3]);
+}
+
+// The level node at x, y inside id.
+uint32_t FindQuad(uint32_t id, int level, long long x, long long y) {
+    while (quadTree.nodes[id].level > level) {
+        QuadNode node = quadTree.nodes[id];
+        long long half = 1LL << (node.level - 1);
+        uint32_t children[4] = {node.nw, node.ne, node.sw, node.se};
+        id = children[(y >= half) * 2 + (x >= half)];
+        x %= half;
+        y %= half;
+    }
+    return id;
+}
+
+void JumpChunks(int exponent) {
+    if (quadTree.nodeCount > quadTreeMaxNodes)
+        FreeQuadTree();
+    if (!quadTree.nodes)
+        InitQuadTree();
+
+    int top = INT_MAX, left = INT_MAX, bottom = INT_MIN, right = INT_MIN;
+    for (int i = 0; i < board.capacity; i++) {
+        Chunk* chunk = &board.slots[i];
+        if (chunk->count) {
+            top = chunk->row < top ? chunk->row : top;
+            left = chunk->col < left ? chunk->col : left;
+            bottom = chunk->row > bottom ? chunk->row : bottom;
+            right = chunk->col > right ? chunk->col : right;
+        }
+    }
+    if (!board.count)
+        return;
+
+    long long chunks = (long long)bottom - top > (long long)right - left
+                           ? (long long)bottom - top + 1
+                           : (long long)right - left + 1;
+    int boardLevel = chunkLevel;
+    while ((1LL << (boardLevel - chunkLevel)) < chunks) {
+        boardLevel++;
+    }
+
+    // As in JumpQuadTree the result is the centre half of the root, which
+    // keeps the chunks aligned as long as the offset is a whole chunk.
+    int level = boardLevel + 1 > exponent + 2 ? boardLevel + 1 : exponent + 2;
+    level = level > chunkLevel + 2 ? level : chunkLevel + 2;
+    long long offset = 1LL << (level - 2);
+    quadTree.step = exponent;
+    uint32_t root = EmptyQuad(level);
+    for (int i = 0; i < board.capacity; i++) {
+        Chunk* chunk = &board.slots[i];
+        if (chunk->count) {
+            root = PlaceQuad(
+                root, offset + ((long long)chunk->col - left) * chunkSize,
+                offset + ((long long)chunk->row - top) * chunkSize,
+                BuildChunkQuad(chunk, chunkLevel, 0, 0));
+        }
+    }
+    uint32_t result = AdvanceQuad(root);
+
+    // Cells never leave their chunks, so writing the chunks back is enough.
+    for (int i = 0; i < board.capacity; i++) {
+        Chunk* chunk = &board.slots[i];
+        if (chunk->count) {
+            uint32_t part = FindQuad(
+                result, chunkLevel, ((long long)chunk->col - left) * chunkSize,
+                ((long long)chunk->row - top) * chunkSize);
+            WriteChunkQuad(part, chunk, 0, 0);
+        }
+    }
+    grid.version++;
+}
+
+// Single generations of a sparse board are stepped chunk by chunk. Each
+// chunk is copied into a haloed tile with the edges of its eight
+// neighbours, and the SIMD kernel writes its next generation to the side,
+// so every chunk reads the same generation. Cells never change between
+// EMPTY and non-EMPTY, so the chunks stay the same as well.
+typedef struct {
+    Cell* tile;  // chunkSize x chunkSize with a grid-style halo
+    int stride;
+    Cell* next;  // chunkSize x chunkSize per chunk, in slot order
+    int capacity;
+} ChunkScratch;
+
+ChunkScratch chunkScratch = {0};
+
+void FreeChunkScratch(void) {
+    FreeCells(chunkScratch.tile, chunkScratch.stride);
+    RL_FREE(chunkScratch.next);
+    chunkScratch = (ChunkScratch){0};
+}
+
+// Copies columns [x, x + width) of row y of the chunk at (row, col) to
+// out, or EMPTY where there is no chunk.
+void CopyChunkEdge(int row, int col, int y, int x, int width, Cell* out) {
+    const Chunk* chunk = FindChunk(row, col);
+    if (chunk)
+        memcpy(out, &ChunkRow(chunk, y)[x], width * sizeof(Cell));
+    else
+        memset(out, EMPTY, width * sizeof(Cell));
+}
+
+void FillChunkTile(const Chunk* chunk) {
+    const int last = chunkSize - 1;
+    int stride = chunkScratch.stride;
+    Cell* tile = chunkScratch.tile;
+    for (int y = 0; y < chunkSize; y++) {
+        memcpy(&tile[y * stride], ChunkRow(chunk, y),
+               chunkSize * sizeof(Cell));
+    }
+
+    Cell* above = &tile[-stride];
+    Cell* below = &tile[chunkSize * stride];
+    CopyChunkEdge(chunk->row - 1, chunk->col - 1, last, last, 1, &above[-1]);
+    CopyChunkEdge(chunk->row - 1, chunk->col, last, 0, chunkSize, above);
+    CopyChunkEdge(chunk->row - 1, chunk->col + 1, last, 0, 1,
+                  &above[chunkSize]);
+    CopyChunkEdge(chunk->row + 1, chunk->col - 1, 0, last, 1, &below[-1]);
+    CopyChunkEdge(chunk->row + 1, chunk->col, 0, 0, chunkSize, below);
+    CopyChunkEdge(chunk->row + 1, chunk->col + 1, 0, 0, 1, &below[chunkSize]);
+
+    const Chunk* west = FindChunk(chunk->row, chunk->col - 1);
+    const Chunk* east = FindChunk(chunk->row, chunk->col + 1);
+    for (int y = 0; y < chunkSize; y++) {
+        tile[y * stride - 1] = west ? ChunkRow(west, y)[last] : EMPTY;
+        tile[y * stride + chunkSize] = east ? ChunkRow(east, y)[0] : EMPTY;
+    }
+}
+
+void UpdateChunks(void) {
+    PrepareSimd();
+    if (!chunkScratch.tile) {
+        chunkScratch.stride = GridStride(chunkSize);
+        chunkScratch.tile = AllocCells(chunkSize, chunkScratch.stride);
+        if (!chunkScratch.tile)
+            OutOfMemory();
+    }
+    if (chunkScratch.capacity < board.count) {
+        RL_FREE(chunkScratch.next);
+        chunkScratch.capacity = board.count;
+        chunkScratch.next =
+            CheckedMalloc((size_t)board.count * chunkSize * chunkSize);
+    }
+
+    int stride = chunkScratch.stride;
+    Cell* next = chunkScratch.next;
+    for (int i = 0; i < board.capacity; i++) {
+        const Chunk* chunk = &board.slots[i];
+        if (!chunk->count)
+            continue;
+        FillChunkTile(chunk);
+        for (int y = 0; y < chunkSize; y++) {
+            const Cell* row = &chunkScratch.tile[y * stride];
+            simdKernel.kernel(row - stride, row, row + stride,
+                              &next[y * chunkSize], 0, chunkSize);
+        }
+        next += chunkSize * chunkSize;
+    }
+
+    next = chunkScratch.next;
+    for (int i = 0; i < board.capacity; i++) {
+        const Chunk* chunk = &board.slots[i];
+        if (!chunk->count)
+            continue;
+        for (int y = 0; y < chunkSize; y++) {
+            memcpy(ChunkRow(chunk, y), &next[y * chunkSize],
+                   chunkSize * sizeof(Cell));
+        }
+        next += chunkSize * chunkSize;
+    }
+    grid.version++;
+}
+
+// Long batches jump by their high bits, where HashLife pays off, and step
+// the rest a generation at a time.
+void StepChunks(int generations) {
+    for (int bit = 30; (1 << bit) >= chunkJumpLimit; bit--) {
+        if (generations & (1 << bit))
+            JumpChunks(bit);
+    }
+    for (int i = 0; i < generations % chunkJumpLimit; i++) {
+        UpdateChunks();
+    }
+}
+
+// Graph engine: conductors never appear or disappear while the simulation
+// runs, so the non-EMPTY cells are compiled once into a compact array with
+// each cell's non-EMPTY neighbours stored in CSR form. Stepping then never
+// touches EMPTY cells or checks bounds; the graph is rebuilt only when the
+// grid is edited.
+typedef struct {
+    unsigned long version;  // grid.version the graph was built from
+    int nodeCount;
+    int* cellIndex;      // node -> index into grid.cells
+    int* neighborStart;  // node -> first entry in neighbors, nodeCount + 1
+    int* neighbors;      // concatenated neighbour node lists
+    Cell* state;
+    Cell* nextState;
+} CellGraph;
+
+CellGraph cellGraph = {0};
+
+void FreeCellGraph(CellGraph* graph) {
+    RL_FREE(graph->cellIndex);
+    RL_FREE(graph->neighborStart);
+    RL_FREE(graph->neighbors);
+    RL_FREE(graph->state);
+    RL_FREE(graph->nextState);
+    *graph = (CellGraph){0};
+}
+
+void BuildCellGraph(CellGraph* graph) {
+    FreeCellGraph(graph);
+
+    // Number the non-EMPTY cells in row-major order.
+    size_t size = (size_t)grid.rows * grid.stride;
+    int* nodeOf = CheckedMalloc(size * sizeof(int));
+    int nodeCount = 0;
+    for (size_t i = 0; i < size; i++) {
+        nodeOf[i] = grid.cells[i] != EMPTY ? nodeCount++ : -1;
+    }
+
+    graph->nodeCount = nodeCount;
+    graph->cellIndex = CheckedMalloc((nodeCount + 1) * sizeof(int));
+    graph->neighborStart = CheckedMalloc((nodeCount + 1) * sizeof(int));
+    graph->neighbors = CheckedMalloc((8 * (size_t)nodeCount + 1) * sizeof(int));
+    graph->state = CheckedMalloc((nodeCount + 1) * sizeof(Cell));
+    graph->nextState = CheckedMalloc((nodeCount + 1) * sizeof(Cell));
+
+    int edgeCount = 0;
+    for (int y = 0; y < grid.rows; y++) {
+        for (int x = 0; x < grid.cols; x++) {
+            int index = y * grid.stride + x;
+            int node = nodeOf[index];
+            if (node < 0)
+                continue;
+
+            graph->cellIndex[node] = index;
+            graph->state[node] = grid.cells[index];
+            graph->neighborStart[node] = edgeCount;
+            for (int dy = -1; dy <= 1; dy++) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    int row = y + dy;
+                    int col = x + dx;
+                    if ((dy == 0 && dx == 0) || row < 0 || row >= grid.rows ||
+                        col < 0 || col >= grid.cols)
+                        continue;
+                    int neighbor = nodeOf[row * grid.stride + col];
+                    if (neighbor >= 0)
+                        graph->neighbors[edgeCount++] = neighbor;
+                }
+            }
+        }
+    }
+    graph->neighborStart[nodeCount] = edgeCount;
+
+    RL_FREE(nodeOf);
+    graph->version = grid.version;
+}
+
+void UpdateCellGraph(void) {
+    const Cell* state = cellGraph.state;
+    Cell* nextState = cellGraph.nextState;
+
+    for (int node = 0; node < cellGraph.nodeCount; node++) {
+        switch (state[node]) {
+            case HEAD:
+                nextState[node] = TAIL;
+                break;
+            case TAIL:
+                nextState[node] = CONDUCTOR;
+                break;
+            default: {
+                int heads = 0;
+                for (int i = cellGraph.neighborStart[node];
+                     i < cellGraph.neighborStart[node + 1]; i++) {
+                    heads += state[cellGraph.neighbors[i]] == HEAD;
+                }
+                nextState[node] = heads == 1 || heads == 2 ? HEAD : CONDUCTOR;
+            } break;
+        }
+    }
+
+    cellGraph.state = nextState;
+    cellGraph.nextState = (Cell*)state;
+}
+
+void StepGraph(int generations) {
+    if (cellGraph.version != grid.version || !cellGraph.state)
+        BuildCellGraph(&cellGraph);
+    for (int i = 0; i < generations; i++) {
+        UpdateCellGraph();
+    }
+
+    for (int node = 0; node < cellGraph.nodeCount; node++) {
+        grid.cells[cellGraph.cellIndex[node]] = cellGraph.state[node];
+    }
+    grid.version++;
+    cellGraph.version = grid.version;
+}
+
+void FreeGraph(void) {
+    FreeCellGraph(&cellGraph);
+}
+
+// Multiverse: 64 or 256 copies of one layout stepped together, one
+// universe per bit lane, for running many input patterns in one pass. The
+// universes share a compiled topology like the graph engine's and each cell
+// holds a head word and a tail word per 64 universes, so the UpdateGrid rule
+// becomes a few bitwise operations. A 256-universe pass is four words per
+// cell, which the avx2 clone handles as one vector.
+#define MULTIVERSE_MAX_WORDS 4
+
+typedef struct {
+    CellGraph topology;
+    int rows, cols, stride;  // grid geometry the topology was built from
+    int words;               // 64 universes per word
+    uint64_t* heads;         // node * words + word
+    uint64_t* tails;
+    uint64_t* nextHeads;
+    uint64_t* nextTails;
+} Multiverse;
+
+Multiverse multiverse = {0};
+
+void FreeMultiverse(void) {
+    FreeCellGraph(&multiverse.topology);
+    RL_FREE(multiverse.heads);
+    RL_FREE(multiverse.tails);
+    RL_FREE(multiverse.nextHeads);
+    RL_FREE(multiverse.nextTails);
+    multiverse = (Multiverse){0};
+}
+
+// Copies the current grid into every universe. Anything above 64 universes
+// gets 256.
+void InitMultiverse(int universes) {
+    FreeMultiverse();
+    BuildCellGraph(&multiverse.topology);
+    multiverse.rows = grid.rows;
+    multiverse.cols = grid.cols;
+    multiverse.stride = grid.stride;
+    multiverse.words = universes > 64 ? MULTIVERSE_MAX_WORDS : 1;
+
+    int words = multiverse.words;
+    size_t size = ((size_t)multiverse.topology.nodeCount * words + 1) *
+                  sizeof(uint64_t);
+    multiverse.heads = CheckedMalloc(size);
+    multiverse.tails = CheckedMalloc(size);
+    multiverse.nextHeads = CheckedMalloc(size);
+    multiverse.nextTails = CheckedMalloc(size);
+    for (int node = 0; node < multiverse.topology.nodeCount; node++) {
+        Cell cell = multiverse.topology.state[node];
+        for (int w = 0; w < words; w++) {
+            multiverse.heads[node * words + w] = cell == HEAD ? ~0ull : 0;
+            multiverse.tails[node * words + w] = cell == TAIL ? ~0ull : 0;
+        }
+    }
+}
+
+// Node of the cell at (row, col), or -1 if it is EMPTY in every universe.
+int FindMultiverseNode(int row, int col) {
+    if (row < 0 || row >= multiverse.rows || col < 0 ||
+        col >= multiverse.cols)
+        return -1;
+
+    // Nodes are numbered in row-major order, so cellIndex is sorted.
+    int index = row * multiverse.stride + col;
+    int low = 0;
+    int high = multiverse.topology.nodeCount - 1;
+    while (low <= high) {
+        int middle = (low + high) / 2;
+        int found = multiverse.topology.cellIndex[middle];
+        if (found == index)
+            return middle;
+        if (found < index)
+            low = middle + 1;
+        else
+            high = middle - 1;
+    }
+    return -1;
+}
+
+// EMPTY cells are shared topology and cannot be changed per universe.
+void SetUniverseCell(int universe, int row, int col, Cell cell) {
+    int node = FindMultiverseNode(row, col);
+    if (node < 0 || cell == EMPTY)
+        return;
+
+    size_t i = (size_t)node * multiverse.words + universe / 64;
+    uint64_t bit = 1ull << (universe % 64);
+    multiverse.heads[i] &= ~bit;
+    multiverse.tails[i] &= ~bit;
+    if (cell == HEAD)
+        multiverse.heads[i] |= bit;
+    else if (cell == TAIL)
+        multiverse.tails[i] |= bit;
+}
+
+Cell GetUniverseNode(int universe, int node) {
+    size_t i = (size_t)node * multiverse.words + universe / 64;
+    uint64_t bit = 1ull << (universe % 64);
+    if (multiverse.heads[i] & bit)
+        return HEAD;
+    return multiverse.tails[i] & bit ? TAIL : CONDUCTOR;
+}
+
+// Copies one universe into the grid, e.g. to draw it.
+void ShowUniverse(int universe) {
+    if (grid.rows != multiverse.rows || grid.cols != multiverse.cols)
+        return;
+    for (int node = 0; node < multiverse.topology.nodeCount; node++) {
+        grid.cells[multiverse.topology.cellIndex[node]] =
+            GetUniverseNode(universe, node);
+    }
+    grid.version++;
+}
+
+__attribute__((target_clones("avx2", "default"))) void UpdateMultiverse(
+    void) {
+    const CellGraph* topology = &multiverse.topology;
+    const uint64_t* heads = multiverse.heads;
+    const uint64_t* tails = multiverse.tails;
+    int words = multiverse.words;
+
+    for (int node = 0; node < topology->nodeCount; node++) {
+        // Bit-sliced head count per universe: ones and twos hold the low
+        // two bits of the count and many is set once it reaches four.
+        uint64_t ones[MULTIVERSE_MAX_WORDS] = {0};
+        uint64_t twos[MULTIVERSE_MAX_WORDS] = {0};
+        uint64_t many[MULTIVERSE_MAX_WORDS] = {0};
+        for (int i = topology->neighborStart[node];
+             i < topology->neighborStart[node + 1]; i++) {
+            const uint64_t* neighbor = heads + topology->neighbors[i] * words;
+            for (int w = 0; w < words; w++) {
+                uint64_t carry = ones[w] & neighbor[w];
+                ones[w] ^= neighbor[w];
+                many[w] |= twos[w] & carry;
+                twos[w] ^= carry;
+            }
+        }
+
+        size_t base = (size_t)node * words;
+        for (int w = 0; w < words; w++) {
+            uint64_t fires = (ones[w] ^ twos[w]) & ~many[w];
+            multiverse.nextHeads[base + w] =
+                fires & ~heads[base + w] & ~tails[base + w];
+            multiverse.nextTails[base + w] = heads[base + w];
+        }
+    }
+
+    multiverse.heads = multiverse.nextHeads;
+    multiverse.tails = multiverse.nextTails;
+    multiverse.nextHeads = (uint64_t*)heads;
+    multiverse.nextTails = (uint64_t*)tails;
+}
+
+void StepMultiverse(int generations) {
+    for (int i = 0; i < generations; i++) {
+        UpdateMultiverse();
+    }
+}
+
+void StepScalar(int generations) {
+    for (int i = 0; i < generations; i++) {
+        UpdateGrid();
+    }
+    grid.version++;
+}
+
+// Frontier engine: only heads, tails and the conductors touching a head can
+// change, so the engine keeps lists of head and tail cells and never looks at
+// the rest of the grid. Cells are stored as indices into grid.cells.
+typedef struct {
+    int* items;
+    int count;
+    int capacity;
+} IndexList;
+
+void PushIndex(IndexList* list, int index) {
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 256;
+        list->items = CheckedRealloc(list->items, list->capacity * sizeof(int));
+    }
+    list->items[list->count++] = index;
+}
+
+typedef struct {
+    unsigned long version;  // grid.version the lists were built from
+    IndexList heads;
+    IndexList tails;
+    IndexList nextHeads;
+    IndexList candidates;
+    uint8_t* headCounts;  // scratch, all zero between generations
+    size_t headCountsSize;
+} Frontier;
+
+Frontier frontier = {0};
+
+void BuildFrontier(void) {
+    size_t size = (size_t)grid.rows * grid.stride;
+    if (frontier.headCountsSize != size) {
+        RL_FREE(frontier.headCounts);
+        frontier.headCounts = CheckedCalloc(size, sizeof(uint8_t));
+        frontier.headCountsSize = size;
+    }
+
+    frontier.heads.count = 0;
+    frontier.tails.count = 0;
+    for (int y = 0; y < grid.rows; y++) {
+        for (int x = 0; x < grid.cols; x++) {
+            int index = y * grid.stride + x;
+            if (grid.cells[index] == HEAD) {
+                PushIndex(&frontier.heads, index);
+            } else if (grid.cells[index] == TAIL) {
+                PushIndex(&frontier.tails, index);
+            }
+        }
+    }
+    frontier.version = grid.version;
+}
+
+void UpdateFrontier(void) {
+    Cell* cells = grid.cells;
+    uint8_t* headCounts = frontier.headCounts;
+
+    int offsets[8];
+    GetNeighborOffsets(offsets);
+
+    // Halo cells are EMPTY, so only in-grid counters are ever touched.
+    frontier.candidates.count = 0;
+    for (int i = 0; i < frontier.heads.count; i++) {
+        int index = frontier.heads.items[i];
+        for (int j = 0; j < 8; j++) {
+            int neighbor = index + offsets[j];
+            if (cells[neighbor] == CONDUCTOR && headCounts[neighbor]++ == 0) {
+                PushIndex(&frontier.candidates, neighbor);
+            }
+        }
+    }
+
+    frontier.nextHeads.count = 0;
+    for (int i = 0; i < frontier.candidates.count; i++) {
+        int index = frontier.candidates.items[i];
+        if (headCounts[index] <= 2) {
+            PushIndex(&frontier.nextHeads, index);
+        }
+        headCounts[index] = 0;
+    }
+
+    for (int i = 0; i < frontier.tails.count; i++) {
+        cells[frontier.tails.items[i]] = CONDUCTOR;
+    }
+    for (int i = 0; i < frontier.heads.count; i++) {
+        cells[frontier.heads.items[i]] = TAIL;
+    }
+    for (int i = 0; i < frontier.nextHeads.count; i++) {
+        cells[frontier.nextHeads.items[i]] = HEAD;
+    }
+
+    IndexList tails = frontier.tails;
+    frontier.tails = frontier.heads;
+    frontier.heads = frontier.nextHeads;
+    frontier.nextHeads = tails;
+}
+
+void FreeFrontier(void) {
+    RL_FREE(frontier.heads.items);
+    RL_FREE(frontier.tails.items);
+    RL_FREE(frontier.nextHeads.items);
+    RL_FREE(frontier.candidates.items);
+    RL_FREE(frontier.headCounts);
+    frontier = (Frontier){0};
+}
+
+void StepFrontier(int generations) {
+    if (frontier.version != grid.version || !frontier.headCounts)
+        BuildFrontier();
+    for (int i = 0; i < generations; i++) {
+        UpdateFrontier();
+    }
+    grid.version++;
+    frontier.version = grid.version;
+}
+
+// Incremental engine: every cell keeps the number of HEAD cells around it.
+// Counters are only touched when a cell becomes or stops being a HEAD, so
+// deciding whether a conductor fires is a single lookup and a generation
+// costs time proportional to the number of electron transitions.
+const uint8_t candidateMark = 0x80;  // set while a cell is on the candidates
+
+typedef struct {
+    unsigned long version;  // grid.version the counters were built from
+    IndexList heads;
+    IndexList tails;
+    IndexList candidates;
+    Cell* headCounts;  // same layout and halo as grid.cells
+    int headCountsStride;
+} IncrementalState;
+
+IncrementalState incremental = {0};
+
+void AddHeadCount(int index, const int offsets[8], int delta) {
+    for (int i = 0; i < 8; i++) {
+        incremental.headCounts[index + offsets[i]] += delta;
+    }
+}
+
+void BuildIncremental(void) {
+    FreeCells(incremental.headCounts, incremental.headCountsStride);
+    incremental.headCounts = AllocCells(grid.rows, grid.stride);
+    if (!incremental.headCounts)
+        OutOfMemory();
+    incremental.headCountsStride = grid.stride;
+
+    int offsets[8];
+    GetNeighborOffsets(offsets);
+
+    incremental.heads.count = 0;
+    incremental.tails.count = 0;
+    for (int y = 0; y < grid.rows; y++) {
+        for (int x = 0; x < grid.cols; x++) {
+            int index = y * grid.stride + x;
+            if (grid.cells[index] == HEAD) {
+                PushIndex(&incremental.heads, index);
+                AddHeadCount(index, offsets, 1);
+            } else if (grid.cells[index] == TAIL) {
+                PushIndex(&incremental.tails, index);
+            }
+        }
+    }
+    incremental.version = grid.version;
+}
+
+void UpdateIncremental(void) {
+    Cell* cells = grid.cells;
+    Cell* headCounts = incremental.headCounts;
+    int offsets[8];
+    GetNeighborOffsets(offsets);
+
+    // Only conductors next to a current head can fire.
+    incremental.candidates.count = 0;
+    for (int i = 0; i < incremental.heads.count; i++) {
+        for (int j = 0; j < 8; j++) {
+            int index = incremental.heads.items[i] + offsets[j];
+            uint8_t headCount = headCounts[index];
+            if (cells[index] == CONDUCTOR && headCount <= 2) {
+                headCounts[index] |= candidateMark;
+                PushIndex(&incremental.candidates, index);
+            }
+        }
+    }
+    for (int i = 0; i < incremental.candidates.count; i++) {
+        headCounts[incremental.candidates.items[i]] &= ~candidateMark;
+    }
+
+    for (int i = 0; i < incremental.tails.count; i++) {
+        cells[incremental.tails.items[i]] = CONDUCTOR;
+    }
+    for (int i = 0; i < incremental.heads.count; i++) {
+        int index = incremental.heads.items[i];
+        cells[index] = TAIL;
+        AddHeadCount(index, offsets, -1);
+    }
+    for (int i = 0; i < incremental.candidates.count; i++) {
+        int index = incremental.candidates.items[i];
+        cells[index] = HEAD;
+        AddHeadCount(index, offsets, 1);
+    }
+
+    IndexList tails = incremental.tails;
+    incremental.tails = incremental.heads;
+    incremental.heads = incremental.candidates;
+    incremental.candidates = tails;
+}
+
+void FreeIncremental(void) {
+    RL_FREE(incremental.heads.items);
+    RL_FREE(incremental.tails.items);
+    RL_FREE(incremental.candidates.items);
+    FreeCells(incremental.headCounts, incremental.headCountsStride);
+    incremental = (IncrementalState){0};
+}
+
+void StepIncremental(int generations) {
+    if (incremental.version != grid.version || !incremental.headCounts)
+        BuildIncremental();
+    for (int i = 0; i < generations; i++) {
+        UpdateIncremental();
+    }
+    grid.version++;
+    incremental.version = grid.version;
+}
+
+// Temporal engine: instead of streaming the whole grid through memory once
+// per generation, each tile is copied with a temporalDepth-cell apron into a
+// small scratch buffer and advanced temporalDepth generations there while
+// it is in cache. Every generation the valid area shrinks by one cell on
+// each side, so after the last one exactly the tile itself is correct.
+const int temporalTileSize = 256;
+const int temporalDepth = 16;
+// Cells per kernel call are rounded up to this, a multiple of every
+// kernel's vector width, so no row ends in a scalar tail.
+const int temporalVector = 64;
+
+typedef struct {
+    Cell* buffers[2];
+    int stride;
+} TemporalScratch;
+
+TemporalScratch temporal = {0};
+
+void FreeTemporal(void) {
+    free(temporal.buffers[0]);
+    free(temporal.buffers[1]);
+    temporal = (TemporalScratch){0};
+}
+
+// Advances rows [startRow, endRow) and columns [startCol, endCol) by depth
+// generations into grid.nextCells.
+void UpdateTemporalTile(int startRow, int endRow, int startCol, int endCol,
+                        int depth) {
+    int height = endRow - startRow + 2 * depth;
+    int width = endCol - startCol + 2 * depth;
+    int stride = temporal.stride;
+    Cell* source = temporal.buffers[0];
+    Cell* target = temporal.buffers[1];
+
+    // Copy the tile and its apron; anything outside the grid is EMPTY.
+    for (int y = 0; y < height; y++) {
+        Cell* local = &source[(size_t)y * stride];
+        int row = startRow - depth + y;
+        memset(local, EMPTY, width * sizeof(Cell));
+        if (row < 0 || row >= grid.rows)
+            continue;
+        int firstCol = startCol - depth > 0 ? startCol - depth : 0;
+        int lastCol = endCol + depth < grid.cols ? endCol + depth : grid.cols;
+        memcpy(&local[firstCol - (startCol - depth)],
+               &grid.cells[(size_t)row * grid.stride + firstCol],
+               (lastCol - firstCol) * sizeof(Cell));
+    }
+
+    // Every row is run over whole vectors from column 1, past the apron on
+    // the right. The cells out there are wrong, but like the apron they
+    // cannot reach the tile within depth generations.
+    int span = (width - 2 + temporalVector - 1) / temporalVector *
+               temporalVector;
+    for (int step = 1; step <= depth; step++) {
+        for (int y = step; y < height - step; y++) {
+            const Cell* row = &source[(size_t)y * stride];
+            simdKernel.kernel(row - stride, row, row + stride,
+                              &target[(size_t)y * stride], 1, 1 + span);
+        }
+        Cell* swap = source;
+        source = target;
+        target = swap;
+    }
+
+    for (int y = startRow; y < endRow; y++) {
+        memcpy(&grid.nextCells[(size_t)y * grid.stride + startCol],
+               &source[(size_t)(y - startRow + depth) * stride + depth],
+               (endCol - startCol) * sizeof(Cell));
+    }
+}
+
+void UpdateGridTemporal(int depth) {
+    for (int startRow = 0; startRow < grid.rows;
+         startRow += temporalTileSize) {
+        int endRow = startRow + temporalTileSize < grid.rows
+                         ? startRow + temporalTileSize
+                         : grid.rows;
+        for (int startCol = 0; startCol < grid.cols;
+             startCol += temporalTileSize) {
+            int endCol = startCol + temporalTileSize < grid.cols
+                             ? startCol + temporalTileSize
+                             : grid.cols;
+            UpdateTemporalTile(startRow, endRow, startCol, endCol, depth);
+        }
+    }
+    SwapGrid();
+}
+
+void StepTemporal(int generations) {
+    PrepareSimd();
+    if (!temporal.buffers[0]) {
+        int size = temporalTileSize + 2 * temporalDepth;
+        int span = (size - 2 + temporalVector - 1) / temporalVector *
+                   temporalVector;
+        temporal.stride = GridStride(1 + span);
+        size_t bytes = (size_t)size * temporal.stride * sizeof(Cell);
+        temporal.buffers[0] = aligned_alloc(gridAlignment, bytes);
+        temporal.buffers[1] = aligned_alloc(gridAlignment, bytes);
+        if (!temporal.buffers[0] || !temporal.buffers[1])
+            OutOfMemory();
+        memset(temporal.buffers[0], EMPTY, bytes);
+        memset(temporal.buffers[1], EMPTY, bytes);
+    }
+
+    while (generations > 0) {
+        int depth = generations < temporalDepth ? generations : temporalDepth;
+        UpdateGridTemporal(depth);
+        generations -= depth;
+    }
+    grid.version++;
+}
+
+// Lookup-table engine: the grid is updated in 2x2 blocks. The next state of
+// a block depends only on which of the surrounding 4x4 cells are heads and
+// on the states of the four block cells, which fits a 20-bit key:
+//   bits 0-3    heads in the row above the block (columns -1 to 2)
+//   bits 4-7    heads left and right of the block's two rows
+//   bits 8-11   heads in the row below the block
+//   bits 12-19  the four block cells, two bits each
+// Each table entry holds the four next states, two bits each, so the whole
+// table is 1 MB and one load replaces four per-cell switches.
+#define BLOCK_KEY_BITS 20
+
+uint8_t* blockTable = NULL;
+
+void BuildBlockTable(void) {
+    blockTable = CheckedMalloc((size_t)1 << BLOCK_KEY_BITS);
+
+    for (uint32_t key = 0; key < (1u << BLOCK_KEY_BITS); key++) {
+        bool heads[4][4] = {0};
+        Cell block[4];
+        for (int x = 0; x < 4; x++) {
+            heads[0][x] = key >> x & 1;
+            heads[3][x] = key >> (8 + x) & 1;
+        }
+        heads[1][0] = key >> 4 & 1;
+        heads[1][3] = key >> 5 & 1;
+        heads[2][0] = key >> 6 & 1;
+        heads[2][3] = key >> 7 & 1;
+        for (int i = 0; i < 4; i++) {
+            block[i] = key >> (12 + 2 * i) & 3;
+            heads[1 + i / 2][1 + i % 2] = block[i] == HEAD;
+        }
+
+        uint8_t next = 0;
+        for (int i = 0; i < 4; i++) {
+            int row = 1 + i / 2;
+            int col = 1 + i % 2;
+            int count = 0;
+            for (int y = -1; y <= 1; y++) {
+                for (int x = -1; x <= 1; x++) {
+                    count += (y != 0 || x != 0) && heads[row + y][col + x];
+                }
+            }
+            Cell cell = block[i];
+            if (cell == HEAD) {
+                cell = TAIL;
+            } else if (cell == TAIL) {
+                cell = CONDUCTOR;
+            } else if (cell == CONDUCTOR && (count == 1 || count == 2)) {
+                cell = HEAD;
+            }
+            next |= cell << (2 * i);
+        }
+        blockTable[key] = next;
+    }
+}
+
+uint32_t RowHeads(const Cell* cells) {
+    return (cells[0] == HEAD) | (cells[1] == HEAD) << 1 |
+           (cells[2] == HEAD) << 2 | (cells[3] == HEAD) << 3;
+}
+
+void UpdateGridBlocks(void) {
+    for (int y = 0; y < grid.rows; y += 2) {
+        const Cell* above = &grid.cells[(size_t)(y - 1) * grid.stride - 1];
+        const Cell* top = above + grid.stride;
+        const Cell* bottom = top + grid.stride;
+        const Cell* below = bottom + grid.stride;
+        Cell* nextTop = &grid.nextCells[(size_t)y * grid.stride];
+        Cell* nextBottom = nextTop + grid.stride;
+        bool hasBottom = y + 1 < grid.rows;
+
+        for (int x = 0; x < grid.cols; x += 2) {
+            uint32_t key = RowHeads(above + x) | (top[x] == HEAD) << 4 |
+                           (top[x + 3] == HEAD) << 5 |
+                           (bottom[x] == HEAD) << 6 |
+                           (bottom[x + 3] == HEAD) << 7 |
+                           RowHeads(below + x) << 8 | top[x + 1] << 12 |
+                           top[x + 2] << 14 | bottom[x + 1] << 16 |
+                           bottom[x + 2] << 18;
+            uint8_t next = blockTable[key];
+
+            // Cells past the last row or column belong to the halo and must
+            // stay EMPTY.
+            bool hasRight = x + 1 < grid.cols;
+            nextTop[x] = next & 3;
+            if (hasRight)
+                nextTop[x + 1] = next >> 2 & 3;
+            if (hasBottom) {
+                nextBottom[x] = next >> 4 & 3;
+                if (hasRight)
+                    nextBottom[x + 1] = next >> 6;
+            }
+        }
+    }
+    SwapGrid();
+}
+
+void FreeBlockTable(void) {
+    RL_FREE(blockTable);
+    blockTable = NULL;
+}
+
+void StepBlocks(int generations) {
+    if (!blockTable)
+        BuildBlockTable();
+    for (int i = 0; i < generations; i++) {
+        UpdateGridBlocks();
+    }
+    grid.version++;
+}
+
+// Separable engine: the head count is a 3x3 box sum, done as a vertical
+// three-row sum per column followed by a horizontal three-wide sum. The
+// column sums slide down the grid, adding the row that enters the window and
+// subtracting the one that leaves, so each cell costs about four adds in
+// straight loops the compiler vectorizes.
+typedef struct {
+    int capacity;
+    uint8_t* columnSums;
+} SlidingWindow;
+
+SlidingWindow slidingWindow = {0};
+
+void FreeSlidingWindow(void) {
+    RL_FREE(slidingWindow.columnSums);
+    slidingWindow = (SlidingWindow){0};
+}
+
+void UpdateGridSeparable(void) {
+    // Columns -1 and cols are halo, so the sums cover cols + 2 columns.
+    if (slidingWindow.capacity < grid.stride + 2) {
+        RL_FREE(slidingWindow.columnSums);
+        slidingWindow.capacity = grid.stride + 2;
+        slidingWindow.columnSums = CheckedMalloc(slidingWindow.capacity);
+    }
+    uint8_t* sums = slidingWindow.columnSums + 1;
+    // Locals, since byte stores may alias the grid fields.
+    int rows = grid.rows;
+    int cols = grid.cols;
+    int stride = grid.stride;
+
+    for (int y = 0; y < rows; y++) {
+        const Cell* row = &grid.cells[(size_t)y * stride];
+        const Cell* below = row + stride;
+        if (y == 0) {
+            const Cell* above = row - stride;
+            for (int x = -1; x <= cols; x++) {
+                sums[x] =
+                    (above[x] == HEAD) + (row[x] == HEAD) + (below[x] == HEAD);
+            }
+        } else {
+            const Cell* leaving = row - 2 * stride;
+            for (int x = -1; x <= cols; x++) {
+                sums[x] += (below[x] == HEAD) - (leaving[x] == HEAD);
+            }
+        }
+
+        Cell* out = &grid.nextCells[(size_t)y * stride];
+        for (int x = 0; x < cols; x++) {
+            Cell cell = row[x];
+            uint8_t heads = sums[x - 1] + sums[x] + sums[x + 1];
+            heads -= cell == HEAD;
+            uint8_t fires = (cell == CONDUCTOR) & ((uint8_t)(heads - 1) < 2);
+            out[x] = cell + (cell == HEAD) + fires - 2 * (cell == TAIL);
+        }
+    }
+
+    SwapGrid();
+}
+
+void StepSeparable(int generations) {
+    for (int i = 0; i < generations; i++) {
+        UpdateGridSeparable();
+    }
+    grid.version++;
+}
+
+// Morton engine: a working copy of the grid in 8x8 tiles, one cache line
+// each, stored in Z-order so that tiles close on the board are close in
+// memory. A cell's eight neighbours then sit in at most four nearby lines
+// instead of three rows a full stride apart. Conductors never change, so
+// all-EMPTY tiles are left out and share a zero tile; the copy is rebuilt
+// only when the grid is edited.
+#define MORTON_TILE 8
+
+typedef struct {
+    unsigned long version;  // grid.version the tiles were built from
+    int tilesX, tilesY;
+    int tileCount;  // non-empty tiles, slots 1 to tileCount
+    int* slots;     // (tilesY + 2) x (tilesX + 2) tile positions -> slot
+    int* positions;  // slot -> index into slots
+    Cell* storage;
+    Cell* cells;  // slot * 64 + row * 8 + col
+    Cell* nextCells;
+} MortonGrid;
+
+MortonGrid morton = {0};
+
+uint32_t SpreadBits(uint32_t value) {
+    value &= 0xffff;
+    value = (value | value << 8) & 0x00ff00ff;
+    value = (value | value << 4) & 0x0f0f0f0f;
+    value = (value | value << 2) & 0x33333333;
+    return (value | value << 1) & 0x55555555;
+}
+
+uint32_t MortonCode(int x, int y) {
+    return SpreadBits(x) | SpreadBits(y) << 1;
+}
+
+int CompareKeys(const void* a, const void* b) {
+    uint64_t left = *(const uint64_t*)a;
+    uint64_t right = *(const uint64_t*)b;
+    return (left > right) - (left < right);
+}
+
+Cell* MortonCell(Cell* cells, int row, int col) {
+    int position = (row / MORTON_TILE + 1) * (morton.tilesX + 2) +
+                   col / MORTON_TILE + 1;
+    return &cells[morton.slots[position] * MORTON_TILE * MORTON_TILE +
+                  row % MORTON_TILE * MORTON_TILE + col % MORTON_TILE];
+}
+
+Cell GetMortonCell(int row, int col) {
+    return *MortonCell(morton.cells, row, col);
+}
+
+// Cells in all-EMPTY tiles cannot be set without rebuilding the tiles.
+void SetMortonCell(int row, int col, Cell cell) {
+    Cell* target = MortonCell(morton.cells, row, col);
+    if (target >= morton.cells + MORTON_TILE * MORTON_TILE)
+        *target = cell;
+}
+
+void FreeMorton(void) {
+    RL_FREE(morton.slots);
+    RL_FREE(morton.positions);
+    free(morton.storage);
+    morton = (MortonGrid){0};
+}
+
+void BuildMorton(void) {
+    FreeMorton();
+    morton.tilesX = (grid.cols + MORTON_TILE - 1) / MORTON_TILE;
+    morton.tilesY = (grid.rows + MORTON_TILE - 1) / MORTON_TILE;
+    int width = morton.tilesX + 2;
+    morton.slots =
+        CheckedCalloc((size_t)width * (morton.tilesY + 2), sizeof(int));
+
+    // Sort the non-empty tiles by Morton code and number them in that order.
+    size_t tiles = (size_t)morton.tilesX * morton.tilesY;
+    uint64_t* keys = CheckedMalloc((tiles + 1) * sizeof(uint64_t));
+    int tileCount = 0;
+    for (int ty = 0; ty < morton.tilesY; ty++) {
+        for (int tx = 0; tx < morton.tilesX; tx++) {
+            int endY = grid.rows < (ty + 1) * MORTON_TILE
+                           ? grid.rows
+                           : (ty + 1) * MORTON_TILE;
+            int endX = grid.cols < (tx + 1) * MORTON_TILE
+                           ? grid.cols
+                           : (tx + 1) * MORTON_TILE;
+            int occupied = 0;
+            for (int y = ty * MORTON_TILE; y < endY && !occupied; y++) {
+                for (int x = tx * MORTON_TILE; x < endX; x++) {
+                    occupied |= GetCell(y, x) != EMPTY;
+                }
+            }
+            if (occupied) {
+                int position = (ty + 1) * width + tx + 1;
+                keys[tileCount++] =
+                    (uint64_t)MortonCode(tx, ty) << 32 | (uint32_t)position;
+            }
+        }
+    }
+    qsort(keys, tileCount, sizeof(uint64_t), CompareKeys);
+
+    morton.tileCount = tileCount;
+    morton.positions = CheckedMalloc((tileCount + 1) * sizeof(int));
+    morton.positions[0] = 0;
+    for (int i = 0; i < tileCount; i++) {
+        int position = (int)(uint32_t)keys[i];
+        morton.slots[position] = i + 1;
+        morton.positions[i + 1] = position;
+    }
+    RL_FREE(keys);
+
+    size_t tileSize = MORTON_TILE * MORTON_TILE;
+    size_t size = 2 * (tileCount + 1) * tileSize * sizeof(Cell);
+    morton.storage = aligned_alloc(gridAlignment, size);
+    if (!morton.storage)
+        OutOfMemory();
+    memset(morton.storage, 0, size);
+    morton.cells = morton.storage;
+    morton.nextCells = morton.storage + (tileCount + 1) * tileSize;
+
+    for (int y = 0; y < grid.rows; y++) {
+        for (int x = 0; x < grid.cols; x++) {
+            SetMortonCell(y, x, GetCell(y, x));
+        }
+    }
+    morton.version = grid.version;
+}
+
+void UpdateMortonTile(int slot) {
+    const int size = MORTON_TILE;
+    const int width = morton.tilesX + 2;
+    const int position = morton.positions[slot];
+    const Cell* around[3][3];
+    for (int dy = 0; dy < 3; dy++) {
+        for (int dx = 0; dx < 3; dx++) {
+            int neighbor = morton.slots[position + (dy - 1) * width + dx - 1];
+            around[dy][dx] = &morton.cells[neighbor * size * size];
+        }
+    }
+
+    // Gather the tile and a one-cell ring from its neighbours.
+    Cell window[MORTON_TILE + 2][MORTON_TILE + 2];
+    for (int y = 0; y < size; y++) {
+        memcpy(&window[y + 1][1], &around[1][1][y * size], size);
+        window[y + 1][0] = around[1][0][y * size + size - 1];
+        window[y + 1][size + 1] = around[1][2][y * size];
+    }
+    memcpy(&window[0][1], &around[0][1][(size - 1) * size], size);
+    memcpy(&window[size + 1][1], &around[2][1][0], size);
+    window[0][0] = around[0][0][size * size - 1];
+    window[0][size + 1] = around[0][2][(size - 1) * size];
+    window[size + 1][0] = around[2][0][size - 1];
+    window[size + 1][size + 1] = around[2][2][0];
+
+    Cell* out = &morton.nextCells[slot * size * size];
+    for (int y = 1; y <= size; y++) {
+        const Cell* above = window[y - 1];
+        const Cell* row = window[y];
+        const Cell* below = window[y + 1];
+        for (int x = 1; x <= size; x++) {
+            uint8_t heads = (above[x - 1] == HEAD) + (above[x] == HEAD) +
+                            (above[x + 1] == HEAD) + (row[x - 1] == HEAD) +
+                            (row[x + 1] == HEAD) + (below[x - 1] == HEAD) +
+                            (below[x] == HEAD) + (below[x + 1] == HEAD);
+            Cell cell = row[x];
+            uint8_t fires = (cell == CONDUCTOR) & ((uint8_t)(heads - 1) < 2);
+            out[(y - 1) * size + x - 1] =
+                cell + (cell == HEAD) + fires - 2 * (cell == TAIL);
+        }
+    }
+}
+
+void StepMorton(int generations) {
+    if (morton.version != grid.version || !morton.storage)
+        BuildMorton();
+    for (int i = 0; i < generations; i++) {
+        for (int slot = 1; slot <= morton.tileCount; slot++) {
+            UpdateMortonTile(slot);
+        }
+        Cell* cells = morton.cells;
+        morton.cells = morton.nextCells;
+        morton.nextCells = cells;
+    }
+
+    for (int slot = 1; slot <= morton.tileCount; slot++) {
+        int position = morton.positions[slot];
+        int row = (position / (morton.tilesX + 2) - 1) * MORTON_TILE;
+        int col = (position % (morton.tilesX + 2) - 1) * MORTON_TILE;
+        for (int y = row; y < row + MORTON_TILE && y < grid.rows; y++) {
+            for (int x = col; x < col + MORTON_TILE && x < grid.cols; x++) {
+                grid.cells[(size_t)y * grid.stride + x] = GetMortonCell(y, x);
+            }
+        }
+    }
+    grid.version++;
+    morton.version = grid.version;
+}
+
+// Moves the grid to cover board rows [top, top + rows) and columns
+// [left, left + cols), keeping the cells it already holds there. Returns
+// false and leaves the grid as it was if there is not enough memory.
+bool ResizeGrid(int top, int left, int rows, int cols) {
+    int stride = GridStride(cols);
+    Cell* cells = AllocCells(rows, stride);
+    Cell* nextCells = AllocCells(rows, stride);
+    if (!cells || !nextCells) {
+        FreeCells(cells, stride);
+        FreeCells(nextCells, stride);
+        return false;
+    }
+
+    long long startRow = top > grid.top ? top : grid.top;
+    long long endRow = (long long)top + rows < (long long)grid.top + grid.rows
+                           ? (long long)top + rows
+                           : (long long)grid.top + grid.rows;
+    long long startCol = left > grid.left ? left : grid.left;
+    long long endCol = (long long)left + cols < (long long)grid.left + grid.cols
+                           ? (long long)left + cols
+                           : (long long)grid.left + grid.cols;
+    for (long long y = startRow; y < endRow && startCol < endCol; y++) {
+        memcpy(&cells[(y - top) * stride + startCol - left],
+               &grid.cells[(y - grid.top) * grid.stride + startCol -
+                           grid.left],
+               (endCol - startCol) * sizeof(Cell));
+    }
+
+    FreeGrid();
+    grid.cells = cells;
+    grid.nextCells = nextCells;
+    grid.top = top;
+    grid.left = left;
+    grid.rows = rows;
+    grid.cols = cols;
+    grid.stride = stride;
+    grid.version++;
+    return true;
+}
+
+// Gives every chunk in the grid its own cells again and drops the grid.
+void ReleaseGrid(void) {
+    for (int i = 0; i < board.capacity; i++) {
+        Chunk* chunk = &board.slots[i];
+        if (!chunk->count || chunk->cells)
+            continue;
+        Cell* cells = CheckedMalloc(chunkSize * chunkSize * sizeof(Cell));
+        for (int y = 0; y < chunkSize; y++) {
+            memcpy(&cells[y * chunkSize], ChunkRow(chunk, y),
+                   chunkSize * sizeof(Cell));
+        }
+        chunk->cells = cells;
+        board.loose++;
+    }
+    if (!ResizeGrid(0, 0, 0, 0))
+        OutOfMemory();
+}
+
+// Engines step the grid, so before they run it is refitted to the bounding
+// box of the chunks whenever chunks were added or removed, and chunks
+// painted outside it move their cells in. Chunks too far apart for a grid
+// of maxCells, or for the memory available, keep their own cells and are
+// stepped by StepChunks instead. Returns whether the grid holds the whole
+// board.
+bool FitGridWithin(long long maxCells) {
+    if (!board.moved)
+        return board.loose == 0;
+    board.moved = false;
+
+    int top = INT_MAX, left = INT_MAX, bottom = INT_MIN, right = INT_MIN;
+    for (int i = 0; i < board.capacity; i++) {
+        Chunk* chunk = &board.slots[i];
+        if (chunk->count) {
+            top = chunk->row < top ? chunk->row : top;
+            left = chunk->col < left ? chunk->col : left;
+            bottom = chunk->row > bottom ? chunk->row : bottom;
+            right = chunk->col > right ? chunk->col : right;
+        }
+    }
+    long long rows = 0, cols = 0;
+    if (board.count) {
+        rows = ((long long)bottom - top + 1) * chunkSize;
+        cols = ((long long)right - left + 1) * chunkSize;
+        top *= chunkSize;
+        left *= chunkSize;
+    } else {
+        top = left = 0;
+    }
+
+    bool fits = rows <= maxCells && cols <= maxCells &&
+                rows * cols <= maxCells;
+    if (fits && (top != grid.top || left != grid.left || rows != grid.rows ||
+                 cols != grid.cols))
+        fits = ResizeGrid(top, left, rows, cols);
+    if (!fits) {
+        ReleaseGrid();
+        return false;
+    }
+
+    for (int i = 0; i < board.capacity && board.loose; i++) {
+        Chunk* chunk = &board.slots[i];
+        Cell* cells = chunk->cells;
+        if (!chunk->count || !cells)
+            continue;
+        chunk->cells = NULL;
+        for (int y = 0; y < chunkSize; y++) {
+            memcpy(ChunkRow(chunk, y), &cells[y * chunkSize],
+                   chunkSize * sizeof(Cell));
+        }
+        RL_FREE(cells);
+        board.loose--;
+    }
+    grid.version++;
+    return true;
+}
+
+// Sparse boards are cheaper to step from their chunks than through a grid
+// that is mostly EMPTY, and the grid costs its area to move as well.
+bool FitGrid(void) {
+    long long sparse = (long long)maxGridSparseness * board.count *
+                       chunkSize * chunkSize;
+    return FitGridWithin(sparse < maxGridCells ? sparse : maxGridCells);
+}
+
+// The first engine is the default.
+Engine engines[] = {
+    {"simd", StepSimd, NULL},
+    {"scalar", StepScalar, NULL},
+    {"bitboard", StepBitboard, FreeBitboard},
+    {"frontier", StepFrontier, FreeFrontier},
+    {"threaded", StepThreaded, StopPool},
+    {"tiled", StepTiled, FreeTiled},
+    {"hashlife", StepHashLife, FreeQuadTree},
+    {"graph", StepGraph, FreeGraph},
+    {"incremental", StepIncremental, FreeIncremental},
+    {"temporal", StepTemporal, FreeTemporal},
+    {"lut", StepBlocks, FreeBlockTable},
+    {"separable", StepSeparable, FreeSlidingWindow},
+    {"morton", StepMorton, FreeMorton},
+};
+const int engineCount = sizeof(engines) / sizeof(engines[0]);
+
+Engine* engine = &engines[0];
+
+void StepGrid(int generations) {
+    if (FitGrid())
+        engine->step(generations);
+    else
+        StepChunks(generations);
+    generation += generations;
+}
+
+// Jumps are always done by HashLife, whichever engine is selected for
+// regular stepping.
+void JumpGrid(int exponent) {
+    if (FitGrid())
+        JumpQuadTree(exponent);
+    else
+        JumpChunks(exponent);
+    generation += 1ULL << exponent;
+}
+
+void ClearGrid(void) {
+    FreeChunks();
+    if (!ResizeGrid(0, 0, 0, 0))
+        OutOfMemory();
+}
+
+// Sets a cell anywhere on the plane, in board coordinates. Returns false if
+// there was no memory for a new chunk.
+bool PaintCell(int row, int col, Cell cell) {
+    int chunkRow = FloorDiv(row, chunkSize);
+    int chunkCol = FloorDiv(col, chunkSize);
+    Chunk* chunk = FindChunk(chunkRow, chunkCol);
+    if (!chunk && cell == EMPTY)
+        return true;
+    if (!chunk && !(chunk = AddChunk(chunkRow, chunkCol))) {
+        fprintf(stderr, "Out of memory painting cell %d,%d\n", row, col);
+        return false;
+    }
+
+    Cell* cells = ChunkRow(chunk, row - chunkRow * chunkSize);
+    Cell* target = &cells[col - chunkCol * chunkSize];
+    Cell old = *target;
+    if (old == cell)
+        return true;
+
+    *target = cell;
+    grid.version++;
+    chunk->count += (cell != EMPTY) - (old != EMPTY);
+    if (chunk->count == 0)
+        RemoveChunk(chunk);
+    return true;
+}
+
+double Now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+// The simulation runs on its own thread and owns the grid and the engine.
+// Edits and controls from the UI are queued and applied by the simulation
+// thread between generations, so they never race with an engine step.
+typedef enum {
+    PAINT_COMMAND,  // row and col in board coordinates
+    STEP_COMMAND,   // value generations
+    JUMP_COMMAND,   // 2^value generations
+    CLEAR_COMMAND,
+    PLAY_COMMAND,   // value is 1 to play, 0 to pause
+    SPEED_COMMAND,  // value generations per second, 0 for unlimited
+    GOTO_COMMAND,   // advance to generation value
+} CommandType;
+
+typedef struct {
+    CommandType type;
+    int row, col;
+    Cell cell;
+    unsigned long long value;
+} Command;
+
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    bool quit;
+    Command* pending;  // filled by the UI under lock
+    int pendingCount;
+    int pendingCapacity;
+    // Board cells on screen, set by the UI under lock and read on every
+    // publish, even in the middle of a goto.
+    int viewTop, viewLeft, viewRows, viewCols;
+    bool viewMoved;  // since the last publish
+    Command* working;  // being applied by the simulation thread
+    int workingCapacity;
+    // Simulation thread only from here on.
+    bool playing;
+    int speed;  // generations per second, 0 for unlimited
+    double nextStep;  // when the next generation is due
+    double wakeTime;
+    int batch;  // generations that fit in the frame budget
+    double rateStart;
+    unsigned long long rateGenerations;
+    double rate;
+    unsigned long long gotoStart;
+    unsigned long long gotoTarget;  // 0 unless a goto is running
+    double gotoBegan;
+    unsigned long long gotosDone;  // GOTO commands finished or cancelled
+} Simulation;
+
+Simulation simulation = {0};
+
+// Set by the UI to the number of gotos queued when Escape was pressed. The
+// goto numbered n (from 1) stops where it is, or is skipped, if n is at most
+// this, so gotos queued after the Escape still run.
+atomic_ullong gotosCancelled = 0;
+
+// Whether the goto being applied, number gotosDone + 1, has been cancelled.
+bool GotoCancelled(void) {
+    return simulation.gotosDone < atomic_load(&gotosCancelled);
+}
+
+// Finished generations reach the renderer through a lock-free triple buffer
+// of snapshots: the simulation fills its back slot and swaps it with the
+// middle one, and the renderer swaps the middle slot out to the front when
+// it holds something newer. Neither side waits for the other.
+typedef struct {
+    Chunk* chunks;  // copies of the chunks in view, cells in storage
+    int chunkCount;
+    int chunkCapacity;
+    Cell* storage;
+    unsigned long long generation;
+    double rate;  // generations per second achieved recently
+    unsigned long long gotoStart;
+    unsigned long long gotoTarget;  // 0 unless a goto is running
+    double gotoEta;                 // seconds, negative until known
+    unsigned long long gotosDone;
+} Snapshot;
+
+// Set in middleSnapshot while the renderer has not taken the middle slot.
+#define SNAPSHOT_FRESH 4
+
+Snapshot snapshots[3] = {0};
+atomic_int middleSnapshot = 1;
+int backSnapshot = 0;   // simulation thread only
+int frontSnapshot = 2;  // render thread only
+
+// Only the chunks the renderer shows are copied, with a chunk to spare on
+// every side so panning does not uncover cells before the next publish.
+void PublishSnapshot(void) {
+    pthread_mutex_lock(&simulation.lock);
+    int viewTop = simulation.viewTop, viewLeft = simulation.viewLeft;
+    int viewRows = simulation.viewRows, viewCols = simulation.viewCols;
+    simulation.viewMoved = false;
+    pthread_mutex_unlock(&simulation.lock);
+
+    Snapshot* snapshot = &snapshots[backSnapshot];
+    snapshot->chunkCount = 0;
+    if (viewRows > 0 && viewCols > 0) {
+        int top = FloorDiv(viewTop, chunkSize) - 1;
+        int left = FloorDiv(viewLeft, chunkSize) - 1;
+        int bottom = FloorDiv(viewTop + viewRows - 1, chunkSize) + 1;
+        int right = FloorDiv(viewLeft + viewCols - 1, chunkSize) + 1;
+        int capacity = (bottom - top + 1) * (right - left + 1);
+        if (snapshot->chunkCapacity < capacity) {
+            RL_FREE(snapshot->chunks);
+            RL_FREE(snapshot->storage);
+            snapshot->chunkCapacity = capacity;
+            snapshot->chunks = CheckedMalloc(capacity * sizeof(Chunk));
+            snapshot->storage =
+                CheckedMalloc((size_t)capacity * chunkSize * chunkSize);
+        }
+        for (int row = top; row <= bottom; row++) {
+            for (int col = left; col <= right; col++) {
+                const Chunk* chunk = FindChunk(row, col);
+                if (!chunk)
+                    continue;
+                Chunk* copy = &snapshot->chunks[snapshot->chunkCount];
+                *copy = *chunk;
+                copy->cells =
+                    &snapshot->storage[(size_t)snapshot->chunkCount++ *
+                                       chunkSize * chunkSize];
+                for (int y = 0; y < chunkSize; y++) {
+                    memcpy(&copy->cells[y * chunkSize], ChunkRow(chunk, y),
+                           chunkSize * sizeof(Cell));
+                }
+            }
+        }
+    }
+    snapshot->generation = generation;
+    snapshot->rate = simulation.rate;
+    snapshot->gotoStart = simulation.gotoStart;
+    snapshot->gotoTarget = simulation.gotoTarget;
+    snapshot->gotosDone = simulation.gotosDone;
+    snapshot->gotoEta = -1.0;
+    if (simulation.gotoTarget && generation > simulation.gotoStart) {
+        double elapsed = Now() - simulation.gotoBegan;
+        snapshot->gotoEta = elapsed * (simulation.gotoTarget - generation) /
+                            (generation - simulation.gotoStart);
+    }
+
+    backSnapshot = atomic_exchange(&middleSnapshot,
+                                   backSnapshot | SNAPSHOT_FRESH) &
+                   ~SNAPSHOT_FRESH;
+}
+
+// The latest published generation, for the render thread.
+const Snapshot* LatestSnapshot(void) {
+    if (atomic_load(&middleSnapshot) & SNAPSHOT_FRESH) {
+        frontSnapshot = atomic_exchange(&middleSnapshot, frontSnapshot) &
+                        ~SNAPSHOT_FRESH;
+    }
+    return &snapshots[frontSnapshot];
+}
+
+void QueueCommand(Command command) {
+    pthread_mutex_lock(&simulation.lock);
+    if (simulation.pendingCount == simulation.pendingCapacity) {
+        simulation.pendingCapacity = simulation.pendingCapacity * 2 + 16;
+        simulation.pending =
+            CheckedRealloc(simulation.pending,
+                           simulation.pendingCapacity * sizeof(Command));
+    }
+    simulation.pending[simulation.pendingCount++] = command;
+    pthread_cond_signal(&simulation.wake);
+    pthread_mutex_unlock(&simulation.lock);
+}
+
+// Moves the view the snapshots cover, waking the simulation to publish it
+// if it is idle.
+void SetView(int top, int left, int rows, int cols) {
+    pthread_mutex_lock(&simulation.lock);
+    simulation.viewTop = top;
+    simulation.viewLeft = left;
+    simulation.viewRows = rows;
+    simulation.viewCols = cols;
+    simulation.viewMoved = true;
+    pthread_cond_signal(&simulation.wake);
+    pthread_mutex_unlock(&simulation.lock);
+}
+
+// Advances to the target generation off the UI thread, publishing progress
+// along the way. HashLife jumps cover the distance in power-of-two slices
+// of at most a 64th of it so the progress keeps moving, and the selected
+// engine runs the last generations, where a jump would not pay off.
+void GotoGeneration(unsigned long long target) {
+    const unsigned long long engineLimit = 1024;
+    if (target <= generation || GotoCancelled())
+        return;
+
+    simulation.gotoStart = generation;
+    simulation.gotoTarget = target;
+    simulation.gotoBegan = Now();
+    PublishSnapshot();
+
+    int maxExponent = 10;
+    while (maxExponent < maxJumpExponent &&
+           2ULL << maxExponent <= (target - generation) / 64)
+        maxExponent++;
+
+    while (generation < target && !GotoCancelled()) {
+        unsigned long long remaining = target - generation;
+        if (remaining < engineLimit) {
+            StepGrid((int)remaining);
+        } else {
+            int exponent = 63 - __builtin_clzll(remaining);
+            JumpGrid(exponent < maxExponent ? exponent : maxExponent);
+        }
+        PublishSnapshot();
+    }
+    simulation.gotoTarget = 0;
+}
+
+void ApplyCommand(Command command) {
+    switch (command.type) {
+        case PAINT_COMMAND:
+            PaintCell(command.row, command.col, command.cell);
+            break;
+        case STEP_COMMAND:
+            StepGrid((int)command.value);
+            break;
+        case JUMP_COMMAND:
+            JumpGrid((int)command.value);
+            break;
+        case CLEAR_COMMAND:
+            ClearGrid();
+            generation = 0;
+            break;
+        case PLAY_COMMAND:
+            simulation.playing = command.value;
+            simulation.nextStep = Now();
+            simulation.wakeTime = simulation.nextStep;
+            simulation.rateStart = Now();
+            simulation.rateGenerations = 0;
+            break;
+        case GOTO_COMMAND:
+            GotoGeneration(command.value);
+            simulation.gotosDone++;
+            break;
+        case SPEED_COMMAND:
+            simulation.speed = (int)command.value;
+            simulation.nextStep = Now();
+            simulation.wakeTime = simulation.nextStep;
+            break;
+    }
+}
+
+// Waits until there are commands to apply or a generation is due.
+// Returns false once the simulation should stop.
+bool WaitForWork(void) {
+    pthread_mutex_lock(&simulation.lock);
+    while (!simulation.quit && simulation.pendingCount == 0 &&
+           !simulation.viewMoved) {
+        if (!simulation.playing) {
+            pthread_cond_wait(&simulation.wake, &simulation.lock);
+            continue;
+        }
+        double now = Now();
+        if (simulation.speed == 0 || now >= simulation.wakeTime)
+            break;
+        double wakeTime = simulation.wakeTime;
+        struct timespec deadline = {(time_t)wakeTime,
+                                    (long)((wakeTime - (time_t)wakeTime) *
+                                           1e9)};
+        pthread_cond_timedwait(&simulation.wake, &simulation.lock, &deadline);
+    }
+
+    // Take the whole batch and leave the UI an empty queue.
+    Command* working = simulation.working;
+    int workingCapacity = simulation.workingCapacity;
+    simulation.working = simulation.pending;
+    simulation.workingCapacity = simulation.pendingCapacity;
+    int workingCount = simulation.pendingCount;
+    simulation.pending = working;
+    simulation.pendingCapacity = workingCapacity;
+    simulation.pendingCount = 0;
+    bool quit = simulation.quit;
+    pthread_mutex_unlock(&simulation.lock);
+
+    for (int i = 0; i < workingCount; i++) {
+        ApplyCommand(simulation.working[i]);
+    }
+    return !quit;
+}
+
+// Runs the generations that are due, at most one frame budget's worth, in
+// a single engine call so batching engines can take them all at once.
+void RunSimulation(void) {
+    double now = Now();
+    int generations = simulation.batch;
+    if (simulation.speed > 0) {
+        double due = (now - simulation.nextStep) * simulation.speed + 1;
+        if (due < 1)
+            return;
+        if (due < generations)
+            generations = (int)due;
+        simulation.nextStep += (double)generations / simulation.speed;
+        // A slow engine runs late rather than building up a backlog.
+        if (simulation.nextStep < now)
+            simulation.nextStep = now;
+        // Fast speeds are batched into one step per frame budget.
+        double earliest = now + frameBudget / 1000.0;
+        simulation.wakeTime = simulation.nextStep > earliest
+                                  ? simulation.nextStep
+                                  : earliest;
+    }
+
+    StepGrid(generations);
+
+    // Size the next batch to take about one frame budget, growing at most
+    // twofold per step so one fast measurement cannot overshoot.
+    double elapsed = Now() - now;
+    double fit = elapsed > 0.0
+                     ? generations * (frameBudget / 1000.0) / elapsed
+                     : 2.0 * generations;
+    if (fit > 2.0 * generations)
+        fit = 2.0 * generations;
+    simulation.batch = fit < 1.0 ? 1 : fit > 1 << 30 ? 1 << 30 : (int)fit;
+    simulation.rateGenerations += generations;
+}
+
+void* SimulationThread(void* arg) {
+    (void)arg;
+    while (WaitForWork()) {
+        if (simulation.playing)
+            RunSimulation();
+
+        double now = Now();
+        if (!simulation.playing) {
+            simulation.rate = 0.0;
+        } else if (now - simulation.rateStart >= 0.5) {
+            simulation.rate =
+                simulation.rateGenerations / (now - simulation.rateStart);
+            simulation.rateStart = now;
+            simulation.rateGenerations = 0;
+        }
+        PublishSnapshot();
+    }
+    return NULL;
+}
+
+void StartSimulation(void) {
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&simulation.wake, &attributes);
+    pthread_condattr_destroy(&attributes);
+    pthread_mutex_init(&simulation.lock, NULL);
+    simulation.speed = speeds[speedIndex];
+    simulation.batch = 1;
+
+    PublishSnapshot();
+    pthread_create(&simulation.thread, NULL, SimulationThread, NULL);
+}
+
+void StopSimulation(void) {
+    pthread_mutex_lock(&simulation.lock);
+    simulation.quit = true;
+    pthread_cond_signal(&simulation.wake);
+    pthread_mutex_unlock(&simulation.lock);
+    atomic_store(&gotosCancelled, ULLONG_MAX);
+    pthread_join(simulation.thread, NULL);
+
+    pthread_cond_destroy(&simulation.wake);
+    pthread_mutex_destroy(&simulation.lock);
+    RL_FREE(simulation.pending);
+    RL_FREE(simulation.working);
+    simulation = (Simulation){0};
+    atomic_store(&gotosCancelled, 0);
+    for (int i = 0; i < 3; i++) {
+        RL_FREE(snapshots[i].chunks);
+        RL_FREE(snapshots[i].storage);
+        snapshots[i] = (Snapshot){0};
+    }
+}
+
+// Patterns are read and written as Golly-style RLE with the WireWorld
+// states: '.' for EMPTY, 'A' for HEAD, 'B' for TAIL and 'C' for CONDUCTOR.
+// A "#CXRLE Pos=x,y Gen=n" line places the pattern on the board and sets
+// the generation, so saved boards load back exactly.
+const char patternSymbols[4] = {
+    [EMPTY] = '.', [CONDUCTOR] = 'C', [HEAD] = 'A', [TAIL] = 'B'};
+
+bool LoadPattern(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return false;
+    }
+
+    ClearGrid();
+    generation = 0;
+    int left = 0, top = 0;
+    int row = 0, col = 0, count = 0;
+    bool done = false, ok = true;
+    char* line = NULL;
+    size_t capacity = 0;
+    while (!done && ok && getline(&line, &capacity, file) >= 0) {
+        char* text = line + strspn(line, " \t");
+        if (strncmp(text, "#CXRLE", 6) == 0) {
+            char* position = strstr(text, "Pos=");
+            char* gen = strstr(text, "Gen=");
+            if (position)
+                sscanf(position, "Pos=%d,%d", &left, &top);
+            if (gen)
+                sscanf(gen, "Gen=%llu", &generation);
+            row = top;
+            col = left;
+            continue;
+        }
+        // Chunks are allocated as cells arrive, so the size line is not
+        // needed.
+        if (text[0] == '#' || text[0] == 'x')
+            continue;
+
+        for (char* c = text; *c && !done && ok; c++) {
+            int run = count > 0 ? count : 1;
+            if (*c >= '0' && *c <= '9') {
+                count = count * 10 + *c - '0';
+                continue;
+            }
+            count = 0;
+            if (*c == '.' || *c == 'b') {
+                col += run;
+            } else if (*c >= 'A' && *c <= 'C') {
+                Cell cell = *c == 'A' ? HEAD : *c == 'B' ? TAIL : CONDUCTOR;
+                for (int i = 0; i < run && ok; i++, col++) {
+                    ok = PaintCell(row, col, cell);
+                }
+            } else if (*c == '$') {
+                row += run;
+                col = left;
+            } else if (*c == '!') {
+                done = true;
+            } else if (*c != ' ' && *c != '\t' && *c != '\r' && *c != '\n') {
+                fprintf(stderr, "%s: unexpected '%c' in pattern\n", path, *c);
+                ok = false;
+                break;
+            }
+        }
+    }
+    free(line);
+    fclose(file);
+    return ok;
+}
 
-int cellSize = 40;
-const int minCellSize = 10;
-const int maxCellSize = 100;
+// Appends a run to an RLE line, wrapping before 70 characters.
+void WriteRun(FILE* file, int count, char symbol, int* lineLength) {
+    char run[16];
+    int length = count > 1 ? snprintf(run, sizeof(run), "%d%c", count, symbol)
+                           : snprintf(run, sizeof(run), "%c", symbol);
+    if (*lineLength + length > 70) {
+        fputc('\n', file);
+        *lineLength = 0;
+    }
+    fputs(run, file);
+    *lineLength += length;
+}
 
-const int gridIncrement = 10;
-const int zoomSpeed = 3;
+// Collects the runs of one row at a time. Trailing EMPTY runs are dropped,
+// and rows without cells only show up in the next row end's count.
+typedef struct {
+    FILE* file;
+    int lineLength;
+    int row;         // row being collected
+    int writtenRow;  // row of the last run written
+    Cell cell;       // run being collected
+    int run;
+} RunWriter;
 
-const int indicatorSize = 40;
-const int indicatorPadding = 20;
-const int indicatorX = screenWidth - indicatorSize * 4 - indicatorPadding;
-const int indicatorY = indicatorPadding;
+void FlushRun(RunWriter* writer) {
+    if (!writer->run)
+        return;
+    if (writer->row > writer->writtenRow) {
+        WriteRun(writer->file, writer->row - writer->writtenRow, '$',
+                 &writer->lineLength);
+        writer->writtenRow = writer->row;
+    }
+    WriteRun(writer->file, writer->run, patternSymbols[writer->cell],
+             &writer->lineLength);
+    writer->run = 0;
+}
 
-const int playButtonX = 20;
-const int playButtonY = 20;
-const int playButtonSize = 40;
-const int playButtonBarWidth = playButtonSize / 4;
-const int playButtonBarGap = playButtonBarWidth;
+void AddRun(RunWriter* writer, Cell cell, int count) {
+    if (count > 0 && cell != writer->cell) {
+        FlushRun(writer);
+        writer->cell = cell;
+    }
+    writer->run += count;
+}
 
-const int nextButtonX = playButtonX + playButtonSize + 20;
-const int nextButtonY = 20;
-const int nextButtonSize = 40;
-const int nextButtonBarWidth = playButtonSize / 4;
+void StartRow(RunWriter* writer, int row) {
+    if (writer->cell != EMPTY)
+        FlushRun(writer);
+    writer->row = row;
+    writer->cell = EMPTY;
+    writer->run = 0;
+}
 
-const Rectangle playButtonRect = {playButtonX, playButtonY, playButtonSize,
-                                  playButtonSize};
-const Rectangle nextButtonRect = {nextButtonX, nextButtonY, nextButtonSize,
-                                  nextButtonSize};
-const Rectangle indicatorGruopRect = {indicatorX, indicatorY, indicatorSize * 4,
-                                      indicatorSize};
+int CompareChunks(const void* a, const void* b) {
+    const Chunk* left = *(const Chunk* const*)a;
+    const Chunk* right = *(const Chunk* const*)b;
+    if (left->row != right->row)
+        return (left->row > right->row) - (left->row < right->row);
+    return (left->col > right->col) - (left->col < right->col);
+}
 
-bool isPlaying = false;
+bool SavePattern(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Cannot write %s\n", path);
+        return false;
+    }
 
-const int refreshRate = 5;
-const float refreshInterval = 1.0f / refreshRate;
+    // Chunks in row-major order, so each band of chunks is written row by
+    // row from left to right, with the gaps between chunks as EMPTY runs.
+    Chunk** chunks = CheckedMalloc((board.count + 1) * sizeof(Chunk*));
+    int chunkCount = 0;
+    int top = INT_MAX, bottom = INT_MIN, left = INT_MAX, right = INT_MIN;
+    for (int i = 0; i < board.capacity; i++) {
+        Chunk* chunk = &board.slots[i];
+        if (!chunk->count)
+            continue;
+        chunks[chunkCount++] = chunk;
+        for (int y = 0; y < chunkSize; y++) {
+            const Cell* cells = ChunkRow(chunk, y);
+            for (int x = 0; x < chunkSize; x++) {
+                if (cells[x] == EMPTY)
+                    continue;
+                int row = chunk->row * chunkSize + y;
+                int col = chunk->col * chunkSize + x;
+                top = row < top ? row : top;
+                bottom = row + 1 > bottom ? row + 1 : bottom;
+                left = col < left ? col : left;
+                right = col + 1 > right ? col + 1 : right;
+            }
+        }
+    }
+    if (!chunkCount)
+        top = bottom = left = right = 0;
+    qsort(chunks, chunkCount, sizeof(Chunk*), CompareChunks);
 
-Cell selectCellType = EMPTY;
-Cell cellTypes[] = {EMPTY, CONDUCTOR, HEAD, TAIL};
+    fprintf(file, "#CXRLE Pos=%d,%d Gen=%llu\n", left, top, generation);
+    fprintf(file, "x = %d, y = %d, rule = WireWorld\n", right - left,
+            bottom - top);
+    RunWriter writer = {file, 0, top, top, EMPTY, 0};
+    for (int first = 0, last = 0; first < chunkCount; first = last) {
+        while (last < chunkCount && chunks[last]->row == chunks[first]->row)
+            last++;
+        int bandTop = chunks[first]->row * chunkSize;
+        for (int y = 0; y < chunkSize; y++) {
+            StartRow(&writer, bandTop + y);
+            int col = left;
+            for (int i = first; i < last; i++) {
+                int chunkLeft = chunks[i]->col * chunkSize;
+                int start = chunkLeft < left ? left - chunkLeft : 0;
+                AddRun(&writer, EMPTY, chunkLeft + start - col);
+                const Cell* cells = ChunkRow(chunks[i], y);
+                for (int x = start; x < chunkSize; x++) {
+                    AddRun(&writer, cells[x], 1);
+                }
+                col = chunkLeft + chunkSize;
+            }
+        }
+    }
+    StartRow(&writer, bottom);
+    fputs("!\n", file);
+    RL_FREE(chunks);
 
-Grid grid = {{0.0f, 0.0f}, screenHeight / 40, screenWidth / 40, NULL};
+    bool ok = !ferror(file);
+    ok &= fclose(file) == 0;
+    if (!ok)
+        fprintf(stderr, "Cannot write %s\n", path);
+    return ok;
+}
 
-Camera2D camera = {0};
+// Headless batch mode: load a pattern, run it without a window and report.
+// It goes through the same StepGrid and engines as the GUI.
+typedef enum {
+    NO_CONDITION,
+    DEAD_CONDITION,  // no HEAD or TAIL cells left
+    HEAD_CONDITION,  // a HEAD at conditionRow, conditionCol
+} Condition;
 
-Color GetCellColor(Cell cell) {
-    switch (cell) {
-        case EMPTY:
-            return EMPTY_COLOR;
-        case HEAD:
-            return HEAD_COLOR;
-        case TAIL:
-            return TAIL_COLOR;
-        case CONDUCTOR:
-            return CONDUCTOR_COLOR;
+bool headless = false;
+const char* patternPath = NULL;
+const char* outputPath = NULL;
+unsigned long long batchGenerations = 0;  // 0 with a condition: no limit
+Condition untilCondition = NO_CONDITION;
+int conditionRow = 0, conditionCol = 0;  // board coordinates
+
+#define MAX_INPUTS 8
+
+int universeCount = 0;  // 0 runs the board on its own
+int inputRows[MAX_INPUTS], inputCols[MAX_INPUTS];  // board coordinates
+int inputCount = 0;
+
+bool ParseCondition(const char* text) {
+    if (strcmp(text, "dead") == 0) {
+        untilCondition = DEAD_CONDITION;
+        return true;
+    }
+    if (sscanf(text, "head:%d,%d", &conditionRow, &conditionCol) == 2) {
+        untilCondition = HEAD_CONDITION;
+        return true;
+    }
+    return false;
+}
+
+// Dead boards stay dead, so --until dead only checks every deadCheckBatch
+// generations. A batch that ends dead is stepped again from a copy of the
+// board, a generation at a time, to find the first dead generation.
+const int deadCheckBatch = 64;
+
+// Copies the cells of every chunk to cells, in slot order. Stepping never
+// adds or removes chunks, so RestoreChunks can copy them back later.
+void SaveChunks(Cell* cells) {
+    for (int i = 0; i < board.capacity; i++) {
+        const Chunk* chunk = &board.slots[i];
+        for (int y = 0; y < chunkSize && chunk->count; y++) {
+            memcpy(cells, ChunkRow(chunk, y), chunkSize * sizeof(Cell));
+            cells += chunkSize;
+        }
+    }
+}
+
+void RestoreChunks(const Cell* cells) {
+    for (int i = 0; i < board.capacity; i++) {
+        Chunk* chunk = &board.slots[i];
+        for (int y = 0; y < chunkSize && chunk->count; y++) {
+            memcpy(ChunkRow(chunk, y), cells, chunkSize * sizeof(Cell));
+            cells += chunkSize;
+        }
+    }
+    grid.version++;
+}
+
+bool ConditionHolds(void) {
+    switch (untilCondition) {
+        case DEAD_CONDITION:
+            for (int i = 0; i < board.capacity; i++) {
+                const Chunk* chunk = &board.slots[i];
+                for (int y = 0; y < chunkSize && chunk->count; y++) {
+                    const Cell* cells = ChunkRow(chunk, y);
+                    for (int x = 0; x < chunkSize; x++) {
+                        if (cells[x] == HEAD || cells[x] == TAIL)
+                            return false;
+                    }
+                }
+            }
+            return true;
+        case HEAD_CONDITION:
+            return GetBoardCell(conditionRow, conditionCol) == HEAD;
         default:
-            return EMPTY_COLOR;
+            return false;
     }
 }
 
-int CountHeadNeighbors(int row, int col) {
-    int headCount = 0;
+// Bit u of holds is set where universe u meets the condition.
+void UniverseConditions(uint64_t holds[MULTIVERSE_MAX_WORDS]) {
+    int words = multiverse.words;
+    for (int w = 0; w < words; w++) {
+        holds[w] = 0;
+    }
+    if (untilCondition == DEAD_CONDITION) {
+        for (int node = 0; node < multiverse.topology.nodeCount; node++) {
+            for (int w = 0; w < words; w++) {
+                holds[w] |= multiverse.heads[node * words + w] |
+                            multiverse.tails[node * words + w];
+            }
+        }
+        for (int w = 0; w < words; w++) {
+            holds[w] = ~holds[w];
+        }
+    } else if (untilCondition == HEAD_CONDITION) {
+        int node = FindMultiverseNode(conditionRow - grid.top,
+                                      conditionCol - grid.left);
+        for (int w = 0; w < words && node >= 0; w++) {
+            holds[w] = multiverse.heads[node * words + w];
+        }
+    }
+}
 
-    for (int y = -1; y <= 1; y++) {
-        for (int x = -1; x <= 1; x++) {
-            if (y == 0 && x == 0)
-                continue;
-            int newRow = row + y;
-            int newCol = col + x;
-            if (newRow >= 0 && newRow < grid.rows && newCol >= 0 &&
-                newCol < grid.cols) {
-                if (grid.cells[newRow][newCol] == HEAD) {
-                    headCount++;
+// out.rle becomes out.3.rle for universe 3.
+char* UniversePath(int universe) {
+    const char* slash = strrchr(outputPath, '/');
+    const char* dot = strrchr(outputPath, '.');
+    int stem = dot && (!slash || dot > slash) ? (int)(dot - outputPath)
+                                              : (int)strlen(outputPath);
+    size_t size = strlen(outputPath) + 16;
+    char* path = CheckedMalloc(size);
+    snprintf(path, size, "%.*s.%d%s", stem, outputPath, universe,
+             outputPath + stem);
+    return path;
+}
+
+// Multiverse batch mode: the loaded board is copied into every universe,
+// and universe u gets a HEAD on input i if bit i of u is set and a
+// CONDUCTOR otherwise, so 2^k universes try every pattern on k inputs.
+// The condition is tracked per universe. Returns the exit status like
+// RunHeadless.
+int RunUniverses(void) {
+    // Universes are stepped on a graph of the grid's non-EMPTY cells, so
+    // even a sparse board needs the grid, once.
+    board.moved = true;
+    if (!FitGridWithin(maxGridCells)) {
+        fprintf(stderr, "The board is too spread out for --universes\n");
+        return 1;
+    }
+    InitMultiverse(universeCount);
+    for (int i = 0; i < inputCount; i++) {
+        int row = inputRows[i] - grid.top;
+        int col = inputCols[i] - grid.left;
+        if (FindMultiverseNode(row, col) < 0) {
+            fprintf(stderr, "Input %d,%d is not on a conductor\n",
+                    inputRows[i], inputCols[i]);
+            return 1;
+        }
+        for (int u = 0; u < universeCount; u++) {
+            SetUniverseCell(u, row, col, u >> i & 1 ? HEAD : CONDUCTOR);
+        }
+    }
+
+    bool met[MULTIVERSE_MAX_WORDS * 64] = {false};
+    unsigned long long metAt[MULTIVERSE_MAX_WORDS * 64] = {0};
+    int unmet = untilCondition ? universeCount : 0;
+    unsigned long long ran = 0;
+    double began = Now();
+    for (;;) {
+        if (untilCondition) {
+            uint64_t holds[MULTIVERSE_MAX_WORDS];
+            UniverseConditions(holds);
+            for (int u = 0; u < universeCount; u++) {
+                if (!met[u] && (holds[u / 64] >> (u % 64) & 1)) {
+                    met[u] = true;
+                    metAt[u] = generation + ran;
+                    unmet--;
                 }
             }
         }
+        if ((untilCondition && !unmet) ||
+            (batchGenerations && ran >= batchGenerations))
+            break;
+
+        unsigned long long remaining = batchGenerations - ran;
+        int generations = untilCondition       ? 1
+                          : remaining < 1 << 30 ? (int)remaining
+                                                : 1 << 30;
+        StepMultiverse(generations);
+        ran += generations;
     }
+    double elapsed = Now() - began;
+    generation += ran;
 
-    return headCount;
+    int status = unmet ? 2 : 0;
+    for (int u = 0; u < universeCount && outputPath; u++) {
+        char* path = UniversePath(u);
+        ShowUniverse(u);
+        if (!SavePattern(path))
+            status = 1;
+        RL_FREE(path);
+    }
+
+    double rate = elapsed > 0.0 ? ran / elapsed : 0.0;
+    printf("engine: multiverse\n");
+    printf("universes: %d\n", universeCount);
+    printf("generations: %llu\n", ran);
+    printf("generation: %llu\n", generation);
+    printf("seconds: %.6f\n", elapsed);
+    printf("generations/s: %.1f\n", rate);
+    printf("cells/s: %.1f\n",
+           rate * board.count * chunkSize * chunkSize * universeCount);
+    for (int u = 0; u < universeCount; u++) {
+        int counts[4] = {0};
+        for (int node = 0; node < multiverse.topology.nodeCount; node++) {
+            counts[GetUniverseNode(u, node)]++;
+        }
+        printf("universe %d: heads %d, tails %d", u, counts[HEAD],
+               counts[TAIL]);
+        if (untilCondition && met[u])
+            printf(", condition met at generation %llu\n", metAt[u]);
+        else if (untilCondition)
+            printf(", condition not met\n");
+        else
+            printf("\n");
+    }
+    return status;
 }
 
-void ClearGrid(void) {
-    for (int y = 0; y < grid.rows; y++) {
-        for (int x = 0; x < grid.cols; x++) {
-            grid.cells[y][x] = EMPTY;
+void FreeAll(void) {
+    FreeGrid();
+    FreeChunks();
+
+    if (engine->release)
+        engine->release();
+    FreeQuadTree();
+    FreeChunkScratch();
+    FreeMultiverse();
+}
+
+// Returns the process exit status: 2 if the condition never held.
+int RunHeadless(void) {
+    if (!patternPath || (!batchGenerations && !untilCondition)) {
+        fprintf(stderr, "--headless needs --load and --generations or "
+                        "--until\n");
+        return 1;
+    }
+
+    if (inputCount && !universeCount) {
+        fprintf(stderr, "--input needs --universes\n");
+        return 1;
+    }
+
+    InitGrid();
+    if (!LoadPattern(patternPath)) {
+        FreeAll();
+        return 1;
+    }
+    if (universeCount) {
+        int status = RunUniverses();
+        FreeAll();
+        return status;
+    }
+
+    unsigned long long start = generation;
+    unsigned long long end = start + batchGenerations;
+    bool met = untilCondition && ConditionHolds();
+    // Boards too sparse for the grid are stepped by StepChunks whatever the
+    // engine, and the stats should say so.
+    const char* engineName = FitGrid() ? engine->name : "chunks";
+    Cell* saved = NULL;
+    if (untilCondition == DEAD_CONDITION)
+        saved = CheckedMalloc((size_t)board.count * chunkSize * chunkSize + 1);
+    int single = 0;  // generations left to step one at a time
+    double began = Now();
+    while (!met && (!batchGenerations || generation < end)) {
+        if (untilCondition == DEAD_CONDITION && !single) {
+            unsigned long long remaining = end - generation;
+            int batch = batchGenerations && remaining < deadCheckBatch
+                            ? (int)remaining
+                            : deadCheckBatch;
+            SaveChunks(saved);
+            StepGrid(batch);
+            met = ConditionHolds();
+            if (met && batch > 1) {
+                RestoreChunks(saved);
+                generation -= batch;
+                met = false;
+                single = batch;
+            }
+        } else if (untilCondition) {
+            StepGrid(1);
+            met = ConditionHolds();
+            single -= single > 0;
+        } else {
+            unsigned long long remaining = end - generation;
+            StepGrid(remaining < 1 << 30 ? (int)remaining : 1 << 30);
+        }
+    }
+    double elapsed = Now() - began;
+    RL_FREE(saved);
+
+    int status = untilCondition && !met ? 2 : 0;
+    if (outputPath && !SavePattern(outputPath))
+        status = 1;
+
+    unsigned long long counts[4] = {0};
+    for (int i = 0; i < board.capacity; i++) {
+        const Chunk* chunk = &board.slots[i];
+        for (int y = 0; y < chunkSize && chunk->count; y++) {
+            const Cell* cells = ChunkRow(chunk, y);
+            for (int x = 0; x < chunkSize; x++) {
+                counts[cells[x]]++;
+            }
         }
     }
+    unsigned long long ran = generation - start;
+    double rate = elapsed > 0.0 ? ran / elapsed : 0.0;
+    printf("engine: %s\n", engineName);
+    printf("generations: %llu\n", ran);
+    printf("generation: %llu\n", generation);
+    if (untilCondition)
+        printf("condition: %s\n", met ? "met" : "not met");
+    printf("seconds: %.6f\n", elapsed);
+    printf("generations/s: %.1f\n", rate);
+    printf("cells/s: %.1f\n",
+           rate * board.count * chunkSize * chunkSize);
+    printf("conductors: %llu\n", counts[CONDUCTOR]);
+    printf("heads: %llu\n", counts[HEAD]);
+    printf("tails: %llu\n", counts[TAIL]);
+
+    FreeAll();
+    return status;
 }
 
-void InitGrid(void) {
-    grid.cells = RL_CALLOC(grid.rows, sizeof(Cell*));
-    for (int y = 0; y < grid.rows; y++) {
-        grid.cells[y] = RL_CALLOC(grid.cols, sizeof(Cell));
+// Benchmark suite: reference circuits built in code from a fixed seed, so
+// every run measures the same boards. Each engine runs each pattern from a
+// fresh copy benchRepetitions times. One untimed generation first builds
+// whatever the engine prepares from the cells, and its one-time setup is
+// kept across repetitions; only the memoized HashLife tree is dropped.
+typedef struct {
+    const char* name;
+    int rows, cols;
+    int generations;
+    void (*build)(int parameter);
+    int parameter;
+} BenchPattern;
+
+const int benchRepetitions = 5;
+bool bench = false;
+bool engineChosen = false;  // --engine limits the suite to one engine
+uint64_t benchSeed = 0;
+int benchRows = 0, benchCols = 0;  // size of the pattern being built
+
+uint32_t BenchRandom(void) {
+    benchSeed ^= benchSeed >> 12;
+    benchSeed ^= benchSeed << 25;
+    benchSeed ^= benchSeed >> 27;
+    return (benchSeed * 2685821657736338717ULL) >> 32;
+}
+
+// Shapes use the pattern symbols, with '.' left untouched.
+const char* const clockShape[] = {".CCC.", "C...C", ".BAC."};
+const char* const diodeShape[] = {".CC..", "CC.CC", ".CC.."};
+
+void PlaceShape(int row, int col, const char* const* shape, int height) {
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; shape[y][x]; x++) {
+            char symbol = shape[y][x];
+            if (symbol == '.' || row + y < 0 || row + y >= benchRows ||
+                col + x < 0 || col + x >= benchCols)
+                continue;
+            PaintCell(row + y, col + x,
+                      symbol == 'A'   ? HEAD
+                      : symbol == 'B' ? TAIL
+                                      : CONDUCTOR);
+        }
     }
 }
 
-void FreeGrid(void) {
-    for (int i = 0; i < grid.rows; i++) {
-        RL_FREE(grid.cells[i]);
+// A period-8 clock feeding a wire with a diode every 16 cells.
+void PlaceDiodeChain(int row, int col, int length) {
+    PlaceShape(row - 1, col, clockShape, 3);
+    for (int x = 5; x < length; x++) {
+        if (x % 16 == 8 && x + 5 <= length) {
+            PlaceShape(row - 1, col + x, diodeShape, 3);
+            x += 4;
+        } else {
+            PaintCell(row, col + x, CONDUCTOR);
+        }
     }
-    RL_FREE(grid.cells);
 }
 
-void UpdateGrid(void) {
-    Cell newCells[grid.rows][grid.cols];
+void PlaceDiodeChains(int top, int left, int rows, int cols) {
+    for (int y = 1; y + 2 <= rows; y += 4) {
+        PlaceDiodeChain(top + y, left, cols - 2);
+    }
+}
 
-    for (int y = 0; y < grid.rows; y++) {
-        for (int x = 0; x < grid.cols; x++) {
-            switch (grid.cells[y][x]) {
-                case EMPTY:
-                    newCells[y][x] = EMPTY;
-                    break;
-                case HEAD:
-                    newCells[y][x] = TAIL;
-                    break;
-                case TAIL:
-                    newCells[y][x] = CONDUCTOR;
-                    break;
-                case CONDUCTOR: {
-                    int headNeighbors = CountHeadNeighbors(y, x);
-                    if (headNeighbors == 1 || headNeighbors == 2) {
-                        newCells[y][x] = HEAD;
-                    } else {
-                        newCells[y][x] = CONDUCTOR;
-                    }
-                } break;
-            }
+// Clocks packed 4 rows by 8 columns apart, each with a short output wire.
+void PlaceClocks(int top, int left, int rows, int cols) {
+    for (int y = 0; y + 3 <= rows; y += 4) {
+        for (int x = 0; x + 8 <= cols; x += 8) {
+            PlaceShape(top + y, left + x, clockShape, 3);
+            PaintCell(top + y + 1, left + x + 5, CONDUCTOR);
+            PaintCell(top + y + 1, left + x + 6, CONDUCTOR);
         }
     }
+}
 
-    for (int y = 0; y < grid.rows; y++) {
-        for (int x = 0; x < grid.cols; x++) {
-            grid.cells[y][x] = newCells[y][x];
+// Parallel wires with no electrons, like the idle storage of a computer.
+void PlaceIdleWires(int top, int left, int rows, int cols) {
+    for (int y = 1; y < rows; y += 4) {
+        for (int x = 2; x < cols - 2; x++) {
+            PaintCell(top + y, left + x, CONDUCTOR);
         }
     }
 }
 
-void ExpandGrid(Direction direction) {
-    int newRows =
-        grid.rows + (direction == UP || direction == DOWN ? gridIncrement : 0);
-    int newCols = grid.cols +
-                  (direction == LEFT || direction == RIGHT ? gridIncrement : 0);
-    int xOffset = (direction == LEFT ? gridIncrement : 0);
-    int yOffset = (direction == UP ? gridIncrement : 0);
+void BuildDiodeBoard(int parameter) {
+    (void)parameter;
+    PlaceDiodeChains(0, 0, benchRows, benchCols);
+}
+
+void BuildClockBoard(int parameter) {
+    (void)parameter;
+    PlaceClocks(0, 0, benchRows, benchCols);
+}
 
-    Cell** newCells = RL_CALLOC(newRows, sizeof(Cell*));
-    for (int y = 0; y < newRows; y++) {
-        newCells[y] = RL_CALLOC(newCols, sizeof(Cell));
+// parameter percent of the cells are non-EMPTY, a tenth of those heads and
+// a tenth tails.
+void BuildRandomBoard(int parameter) {
+    for (int y = 0; y < benchRows; y++) {
+        for (int x = 0; x < benchCols; x++) {
+            if ((int)(BenchRandom() % 100) >= parameter)
+                continue;
+            uint32_t kind = BenchRandom() % 10;
+            PaintCell(y, x, kind == 0 ? HEAD : kind == 1 ? TAIL : CONDUCTOR);
+        }
     }
+}
 
-    for (int y = 0; y < grid.rows; y++) {
-        for (int x = 0; x < grid.cols; x++) {
-            newCells[y + yOffset][x + xOffset] = grid.cells[y][x];
+// A large board laid out in 256x256 blocks like a computer: half idle
+// storage, some diode buses and a few banks of clocks.
+void BuildComputerBoard(int parameter) {
+    (void)parameter;
+    const int block = 256;
+    for (int y = 0; y + block <= benchRows; y += block) {
+        for (int x = 0; x + block <= benchCols; x += block) {
+            uint32_t kind = BenchRandom() % 10;
+            if (kind < 5)
+                PlaceIdleWires(y, x, block, block);
+            else if (kind < 8)
+                PlaceDiodeChains(y, x, block, block);
+            else
+                PlaceClocks(y, x, block, block);
         }
     }
+}
 
-    FreeGrid();
+const BenchPattern benchPatterns[] = {
+    {"diodes", 256, 2048, 200, BuildDiodeBoard, 0},
+    {"clocks", 512, 512, 200, BuildClockBoard, 0},
+    {"random-5", 512, 512, 100, BuildRandomBoard, 5},
+    {"random-25", 512, 512, 100, BuildRandomBoard, 25},
+    {"random-50", 512, 512, 100, BuildRandomBoard, 50},
+    {"random-90", 512, 512, 100, BuildRandomBoard, 90},
+    {"computer", 2048, 2048, 50, BuildComputerBoard, 0},
+};
+const int benchPatternCount = sizeof(benchPatterns) / sizeof(benchPatterns[0]);
+
+void BuildBenchPattern(const BenchPattern* pattern) {
+    ClearGrid();
+    benchRows = pattern->rows;
+    benchCols = pattern->cols;
+    benchSeed = 0x9E3779B97F4A7C15ULL;
+    pattern->build(pattern->parameter);
+    FitGrid();
+    generation = 0;
+}
+
+// Branch misses of this thread and the threads it starts, or -1 where the
+// kernel offers no hardware counters.
+int OpenMissCounter(void) {
+    struct perf_event_attr attributes = {0};
+    attributes.type = PERF_TYPE_HARDWARE;
+    attributes.size = sizeof(attributes);
+    attributes.config = PERF_COUNT_HW_BRANCH_MISSES;
+    attributes.disabled = 1;
+    attributes.inherit = 1;
+    attributes.exclude_kernel = 1;
+    return syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+}
+
+int CompareDoubles(const void* a, const void* b) {
+    double left = *(const double*)a;
+    double right = *(const double*)b;
+    return (left > right) - (left < right);
+}
+
+double Median(double* values, int count) {
+    qsort(values, count, sizeof(double), CompareDoubles);
+    return count % 2 ? values[count / 2]
+                     : (values[count / 2 - 1] + values[count / 2]) / 2.0;
+}
+
+double Variance(const double* values, int count) {
+    double mean = 0.0, sum = 0.0;
+    for (int i = 0; i < count; i++) {
+        mean += values[i] / count;
+    }
+    for (int i = 0; i < count; i++) {
+        sum += (values[i] - mean) * (values[i] - mean);
+    }
+    return count > 1 ? sum / (count - 1) : 0.0;
+}
+
+void BenchEngine(const BenchPattern* pattern, int missCounter) {
+    double cells = (double)pattern->rows * pattern->cols;
+    double rates[benchRepetitions];
+    double nanoseconds[benchRepetitions];
+    double misses[benchRepetitions];
+    for (int i = 0; i < benchRepetitions; i++) {
+        FreeQuadTree();
+        BuildBenchPattern(pattern);
+        StepGrid(1);
+
+        long long missCount = 0;
+        if (missCounter >= 0) {
+            ioctl(missCounter, PERF_EVENT_IOC_RESET, 0);
+            ioctl(missCounter, PERF_EVENT_IOC_ENABLE, 0);
+        }
+        double began = Now();
+        StepGrid(pattern->generations);
+        double elapsed = Now() - began;
+        if (missCounter >= 0) {
+            ioctl(missCounter, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(missCounter, &missCount, sizeof(missCount)) < 0)
+                missCount = 0;
+        }
+
+        rates[i] = pattern->generations / elapsed;
+        nanoseconds[i] = elapsed * 1e9 / (cells * pattern->generations);
+        misses[i] = missCount / (cells * pattern->generations);
+    }
 
-    grid.cells = newCells;
-    grid.rows = newRows;
-    grid.cols = newCols;
+    double variance = Variance(nanoseconds, benchRepetitions);
+    double rate = Median(rates, benchRepetitions);
+    printf("%-10s %-12s %12.1f %12.3e %9.3f %10.2e", pattern->name,
+           engine->name, rate, rate * cells,
+           Median(nanoseconds, benchRepetitions), variance);
+    if (missCounter >= 0)
+        printf(" %11.4f\n", Median(misses, benchRepetitions));
+    else
+        printf(" %11s\n", "n/a");
+    fflush(stdout);
+}
+
+int RunBench(void) {
+    int missCounter = OpenMissCounter();
+    Engine* selected = engine;
+
+    InitGrid();
+    printf("%d repetitions per engine and pattern, medians with the variance "
+           "of ns/cell\n",
+           benchRepetitions);
+    printf("%-10s %-12s %12s %12s %9s %10s %11s\n", "pattern", "engine",
+           "gens/s", "cells/s", "ns/cell", "variance", "misses/cell");
+    for (int p = 0; p < benchPatternCount; p++) {
+        for (int e = 0; e < engineCount; e++) {
+            if (engineChosen && &engines[e] != selected)
+                continue;
+            engine = &engines[e];
+            BenchEngine(&benchPatterns[p], missCounter);
+            if (engine->release)
+                engine->release();
+        }
+    }
 
-    grid.position.x -= cellSize * xOffset;
-    grid.position.y -= cellSize * yOffset;
+    if (missCounter >= 0)
+        close(missCounter);
+    engine = selected;
+    FreeAll();
+    return 0;
 }
 
-void DrawCell(int xGridPos, int yGridPos, Color cellColor) {
-    DrawRectangle(grid.position.x + xGridPos * cellSize,
-                  grid.position.y + yGridPos * cellSize, cellSize, cellSize,
+void DrawCell(int xBoardPos, int yBoardPos, Color cellColor) {
+    DrawRectangle(boardPosition.x + xBoardPos * cellSize,
+                  boardPosition.y + yBoardPos * cellSize, cellSize, cellSize,
                   cellColor);
-    DrawRectangleLines(grid.position.x + xGridPos * cellSize,
-                       grid.position.y + yGridPos * cellSize, cellSize,
+    DrawRectangleLines(boardPosition.x + xBoardPos * cellSize,
+                       boardPosition.y + yBoardPos * cellSize, cellSize,
                        cellSize, BLACK);
 }
 
-void DrawCellLines(int xGridPos, int yGridPos, Color cellColor) {
-    DrawRectangleLines(grid.position.x + xGridPos * cellSize,
-                       grid.position.y + yGridPos * cellSize, cellSize,
+void DrawCellLines(int xBoardPos, int yBoardPos, Color cellColor) {
+    DrawRectangleLines(boardPosition.x + xBoardPos * cellSize,
+                       boardPosition.y + yBoardPos * cellSize, cellSize,
                        cellSize, cellColor);
 }
 
@@ -251,32 +4072,75 @@ void DrawNextButton(void) {
     }
 }
 
-void DrawUI(void) {
+void DrawStatus(const Snapshot* view) {
+    DrawText(TextFormat("Generation %llu", view->generation), statusX, statusY,
+             statusFontSize, WHITE);
+    DrawText(TextFormat("J: jump 2^%d generations ([ and ] to change)",
+                        jumpExponent),
+             statusX, statusY + statusLineHeight, statusFontSize, WHITE);
+    const char* speed = speeds[speedIndex] > 0
+                            ? TextFormat("%d gen/s", speeds[speedIndex])
+                            : "max";
+    DrawText(TextFormat("Speed %s (- and = to change), running at %.0f gen/s",
+                        speed, view->rate),
+             statusX, statusY + 2 * statusLineHeight, statusFontSize, WHITE);
+
+    const char* gotoStatus = "G: go to generation";
+    if (enteringGoto) {
+        gotoStatus = TextFormat("Go to generation %s_ (Enter to go, Esc to "
+                                "cancel)",
+                                gotoInput);
+    } else if (view->gotoTarget) {
+        double progress = 100.0 * (view->generation - view->gotoStart) /
+                          (view->gotoTarget - view->gotoStart);
+        const char* eta = view->gotoEta >= 0.0
+                              ? TextFormat("%.1f s", view->gotoEta)
+                              : "unknown";
+        gotoStatus = TextFormat("Going to generation %llu: %.0f%%, ETA %s "
+                                "(Esc to cancel)",
+                                view->gotoTarget, progress, eta);
+    } else if (gotosQueued != view->gotosDone) {
+        gotoStatus = "Going to generation (Esc to cancel)";
+    }
+    DrawText(gotoStatus, statusX, statusY + 3 * statusLineHeight,
+             statusFontSize, WHITE);
+}
+
+void DrawUI(const Snapshot* view) {
     DrawIndicators();
     DrawPlayButton();
     DrawNextButton();
+    DrawStatus(view);
 }
 
 void HandleCellPlacements(void) {
     Vector2 mousePosition = GetMousePosition();
-    Vector2 mouseScreenPosition = GetScreenToWorld2D(mousePosition, camera);
-    mouseScreenPosition = Vector2Subtract(mouseScreenPosition, grid.position);
-    int mouseYGridPos = (int)(mouseScreenPosition.y / cellSize);
-    int mouseXGridPos = (int)(mouseScreenPosition.x / cellSize);
+    Vector2 mouseWorldPosition = GetScreenToWorld2D(mousePosition, camera);
+    Vector2 mouseBoardPosition =
+        Vector2Subtract(mouseWorldPosition, boardPosition);
+    int mouseYBoardPos = (int)floorf(mouseBoardPosition.y / cellSize);
+    int mouseXBoardPos = (int)floorf(mouseBoardPosition.x / cellSize);
 
     if (IsMouseButtonDown(MOUSE_BUTTON_LEFT) &&
         !CheckCollisionPointRec(mousePosition, playButtonRect) &&
         !CheckCollisionPointRec(mousePosition, nextButtonRect) &&
         !CheckCollisionPointRec(mousePosition, indicatorGruopRect)) {
-        if ((mouseXGridPos >= 0 && mouseXGridPos < grid.cols) &&
-            (mouseYGridPos >= 0 && mouseYGridPos < grid.rows)) {
-            grid.cells[mouseYGridPos][mouseXGridPos] = selectCellType;
-            DrawCell(mouseXGridPos, mouseYGridPos,
-                     GetCellColor(selectCellType));
-        }
+        QueueCommand((Command){PAINT_COMMAND, mouseYBoardPos, mouseXBoardPos,
+                               selectCellType, 0});
+        DrawCell(mouseXBoardPos, mouseYBoardPos, GetCellColor(selectCellType));
     }
 
-    DrawCellLines(mouseXGridPos, mouseYGridPos, WHITE);
+    DrawCellLines(mouseXBoardPos, mouseYBoardPos, WHITE);
+}
+
+void TogglePlaying(void) {
+    isPlaying = !isPlaying;
+    QueueCommand((Command){PLAY_COMMAND, 0, 0, EMPTY, isPlaying});
+}
+
+void SetSpeed(int index) {
+    speedIndex = index;
+    QueueCommand((Command){SPEED_COMMAND, 0, 0, EMPTY, speeds[speedIndex]});
 }
 
 void HandleButtonClicks(void) {
@@ -284,10 +4148,10 @@ void HandleButtonClicks(void) {
 
     if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) {
         if (CheckCollisionPointRec(mousePosition, playButtonRect))
-            isPlaying = !isPlaying;
+            TogglePlaying();
 
         if (CheckCollisionPointRec(mousePosition, nextButtonRect) && !isPlaying)
-            UpdateGrid();
+            QueueCommand((Command){STEP_COMMAND, 0, 0, EMPTY, 1});
 
         for (int i = 0; i < 4; i++) {
             int x = indicatorX + indicatorSize * i;
@@ -301,16 +4165,74 @@ void HandleButtonClicks(void) {
     }
 }
 
-void HandleShortcuts(void) {
+void HandleGotoInput(void) {
+    int length = strlen(gotoInput);
+    for (int key = GetCharPressed(); key > 0; key = GetCharPressed()) {
+        if (key >= '0' && key <= '9' && length < 19) {
+            gotoInput[length++] = key;
+            gotoInput[length] = '\0';
+        }
+    }
+    if (IsKeyPressed(KEY_BACKSPACE) && length > 0)
+        gotoInput[length - 1] = '\0';
+
+    if (IsKeyPressed(KEY_ENTER) || IsKeyPressed(KEY_KP_ENTER)) {
+        if (length > 0) {
+            QueueCommand((Command){GOTO_COMMAND, 0, 0, EMPTY,
+                                   strtoull(gotoInput, NULL, 10)});
+            gotosQueued++;
+        }
+        enteringGoto = false;
+    } else if (IsKeyPressed(KEY_ESCAPE)) {
+        enteringGoto = false;
+    }
+}
+
+void HandleShortcuts(const Snapshot* view) {
+    if (enteringGoto) {
+        HandleGotoInput();
+        return;
+    }
+
+    // Escape cancels a queued or running goto and otherwise quits.
+    if (IsKeyPressed(KEY_ESCAPE)) {
+        if (gotosQueued != view->gotosDone)
+            atomic_store(&gotosCancelled, gotosQueued);
+        else
+            quitRequested = true;
+    }
+
+    if (IsKeyPressed(KEY_G)) {
+        enteringGoto = true;
+        gotoInput[0] = '\0';
+        // Drop the G itself from the typed characters.
+        while (GetCharPressed() > 0) {
+        }
+    }
+
     if (IsKeyPressed(KEY_SPACE))
-        isPlaying = !isPlaying;
+        TogglePlaying();
 
     if (IsKeyPressed(KEY_N) && !isPlaying) {
-        UpdateGrid();
+        QueueCommand((Command){STEP_COMMAND, 0, 0, EMPTY, 1});
     }
 
+    if (IsKeyPressed(KEY_J)) {
+        QueueCommand((Command){JUMP_COMMAND, 0, 0, EMPTY, jumpExponent});
+    }
+
+    if (IsKeyPressed(KEY_MINUS) && speedIndex > 0)
+        SetSpeed(speedIndex - 1);
+    else if (IsKeyPressed(KEY_EQUAL) && speedIndex < speedCount - 1)
+        SetSpeed(speedIndex + 1);
+
+    if (IsKeyPressed(KEY_LEFT_BRACKET) && jumpExponent > 0)
+        jumpExponent--;
+    else if (IsKeyPressed(KEY_RIGHT_BRACKET) && jumpExponent < maxJumpExponent)
+        jumpExponent++;
+
     if (IsKeyPressed(KEY_C)) {
-        ClearGrid();
+        QueueCommand((Command){CLEAR_COMMAND, 0, 0, EMPTY, 0});
     }
 
     if (IsKeyPressed(KEY_ONE) || IsKeyPressed(KEY_KP_1))
@@ -337,104 +4259,225 @@ void HandleZoom(void) {
         int newCellSize = cellSize + wheel * zoomSpeed;
         if (newCellSize >= minCellSize && newCellSize <= maxCellSize) {
             Vector2 mousePos = GetScreenToWorld2D(GetMousePosition(), camera);
-            Vector2 gridPos =
-                Vector2Divide(Vector2Subtract(mousePos, grid.position),
+            Vector2 boardPos =
+                Vector2Divide(Vector2Subtract(mousePos, boardPosition),
                               (Vector2){cellSize, cellSize});
 
             cellSize = newCellSize;
 
-            grid.position = Vector2Subtract(
+            boardPosition = Vector2Subtract(
                 mousePos,
-                Vector2Multiply(gridPos, (Vector2){cellSize, cellSize}));
+                Vector2Multiply(boardPos, (Vector2){cellSize, cellSize}));
         }
     }
 }
 
-void HandleUserInput(void) {
+// The board cells on screen, ends exclusive.
+void GetVisibleCells(int* startX, int* startY, int* endX, int* endY) {
+    Vector2 topLeft = GetScreenToWorld2D(Vector2Zero(), camera);
+    Vector2 bottomRight =
+        GetScreenToWorld2D((Vector2){screenWidth, screenHeight}, camera);
+    *startX = (int)floor((topLeft.x - boardPosition.x) / cellSize);
+    *startY = (int)floor((topLeft.y - boardPosition.y) / cellSize);
+    *endX = (int)ceil((bottomRight.x - boardPosition.x) / cellSize);
+    *endY = (int)ceil((bottomRight.y - boardPosition.y) / cellSize);
+}
+
+// Tells the simulation which cells are on screen whenever that changes,
+// since snapshots only carry those.
+void SendView(void) {
+    int startX, startY, endX, endY;
+    GetVisibleCells(&startX, &startY, &endX, &endY);
+    int rows = endY - startY;
+    int cols = endX - startX;
+    if (startY == sentTop && startX == sentLeft && rows == sentRows &&
+        cols == sentCols)
+        return;
+
+    sentTop = startY;
+    sentLeft = startX;
+    sentRows = rows;
+    sentCols = cols;
+    SetView(startY, startX, rows, cols);
+}
+
+void HandleUserInput(const Snapshot* view) {
     HandleCellPlacements();
     HandleButtonClicks();
-    HandleShortcuts();
+    HandleShortcuts(view);
     HandleCameraMovement();
     HandleZoom();
+    SendView();
+}
 
-    Vector2 cameraOffset = Vector2Subtract(camera.target, grid.position);
-    if (cameraOffset.x < 0) {
-        ExpandGrid(LEFT);
-    }
-    if (cameraOffset.y < 0) {
-        ExpandGrid(UP);
+void DrawVisibleCells(const Snapshot* view) {
+    Vector2 origin = boardPosition;
+    int startX, startY, endX, endY;
+    GetVisibleCells(&startX, &startY, &endX, &endY);
+
+    // The view is independent of the storage: everything starts out EMPTY,
+    // and only stored non-EMPTY cells are drawn on top, so the cost follows
+    // the circuit in view rather than the number of visible cells.
+    float left = origin.x + startX * cellSize;
+    float top = origin.y + startY * cellSize;
+    float width = (endX - startX) * cellSize;
+    float height = (endY - startY) * cellSize;
+    DrawRectangle(left, top, width, height, EMPTY_COLOR);
+
+    for (int i = 0; i < view->chunkCount; i++) {
+        const Chunk* chunk = &view->chunks[i];
+        int chunkTop = chunk->row * chunkSize;
+        int chunkLeft = chunk->col * chunkSize;
+        int chunkStartY = Clamp(startY - chunkTop, 0, chunkSize);
+        int chunkStartX = Clamp(startX - chunkLeft, 0, chunkSize);
+        int chunkEndY = Clamp(endY - chunkTop, 0, chunkSize);
+        int chunkEndX = Clamp(endX - chunkLeft, 0, chunkSize);
+        for (int y = chunkStartY; y < chunkEndY; y++) {
+            const Cell* row = &chunk->cells[y * chunkSize];
+            for (int x = chunkStartX; x < chunkEndX; x++) {
+                if (row[x] != EMPTY) {
+                    DrawRectangle(origin.x + (chunkLeft + x) * cellSize,
+                                  origin.y + (chunkTop + y) * cellSize,
+                                  cellSize, cellSize, GetCellColor(row[x]));
+                }
+            }
+        }
     }
-    if (cameraOffset.x + screenWidth > grid.position.x + grid.cols * cellSize) {
-        ExpandGrid(RIGHT);
+
+    // Each cell outline covers the last pixel of one cell and the first
+    // pixel of the next, so draw the grid as two-pixel lines on the seams.
+    for (int x = startX; x <= endX; x++) {
+        DrawRectangle(origin.x + x * cellSize - 1, top, 2, height, BLACK);
     }
-    if (cameraOffset.y + screenHeight >
-        grid.position.y + grid.rows * cellSize) {
-        ExpandGrid(DOWN);
+    for (int y = startY; y <= endY; y++) {
+        DrawRectangle(left, origin.y + y * cellSize - 1, width, 2, BLACK);
     }
 }
 
-void DrawVisibleCells(void) {
-    Vector2 topLeft = GetScreenToWorld2D(Vector2Zero(), camera);
-    Vector2 bottomRight =
-        GetScreenToWorld2D((Vector2){screenWidth, screenHeight}, camera);
-
-    int startX = (int)floor((topLeft.x - grid.position.x) / cellSize);
-    int startY = (int)floor((topLeft.y - grid.position.y) / cellSize);
-    int endX = (int)ceil((bottomRight.x - grid.position.x) / cellSize);
-    int endY = (int)ceil((bottomRight.y - grid.position.y) / cellSize);
+bool SelectEngine(const char* name) {
+    for (int i = 0; i < engineCount; i++) {
+        if (strcmp(engines[i].name, name) == 0) {
+            engine = &engines[i];
+            return true;
+        }
+    }
+    return false;
+}
 
-    startX = Clamp(startX, 0, grid.cols);
-    startY = Clamp(startY, 0, grid.rows);
-    endX = Clamp(endX, 0, grid.cols);
-    endY = Clamp(endY, 0, grid.rows);
+void PrintUsage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [--engine NAME] [--threads N] [--budget MS] "
+            "[--load FILE]\n"
+            "       %s --headless --load FILE [--generations N] "
+            "[--until COND]\n"
+            "          [--output FILE] [--engine NAME] [--threads N]\n"
+            "          [--universes N [--input ROW,COL]...]\n"
+            "       %s --bench [--engine NAME] [--threads N]\n"
+            "Conditions: dead, head:ROW,COL\n",
+            program, program, program);
+    fprintf(stderr, "Engines:");
+    for (int i = 0; i < engineCount; i++) {
+        fprintf(stderr, " %s", engines[i].name);
+    }
+    fprintf(stderr, "\n");
+}
 
-    for (int y = startY; y < endY; y++) {
-        for (int x = startX; x < endX; x++) {
-            Color cellColor = GetCellColor(grid.cells[y][x]);
-            DrawCell(x, y, cellColor);
+bool ParseArgs(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+            if (!SelectEngine(argv[++i])) {
+                fprintf(stderr, "Unknown engine: %s\n", argv[i]);
+                return false;
+            }
+            engineChosen = true;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threadCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--budget") == 0 && i + 1 < argc) {
+            frameBudget = atof(argv[++i]);
+            if (frameBudget <= 0.0f)
+                return false;
+        } else if (strcmp(argv[i], "--headless") == 0) {
+            headless = true;
+        } else if (strcmp(argv[i], "--bench") == 0) {
+            bench = true;
+        } else if (strcmp(argv[i], "--load") == 0 && i + 1 < argc) {
+            patternPath = argv[++i];
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (strcmp(argv[i], "--generations") == 0 && i + 1 < argc) {
+            batchGenerations = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--universes") == 0 && i + 1 < argc) {
+            universeCount = atoi(argv[++i]);
+            if (universeCount < 1 || universeCount > MULTIVERSE_MAX_WORDS * 64)
+                return false;
+        } else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc &&
+                   inputCount < MAX_INPUTS) {
+            if (sscanf(argv[++i], "%d,%d", &inputRows[inputCount],
+                       &inputCols[inputCount]) != 2)
+                return false;
+            inputCount++;
+        } else if (strcmp(argv[i], "--until") == 0 && i + 1 < argc) {
+            if (!ParseCondition(argv[++i])) {
+                fprintf(stderr, "Unknown condition: %s\n", argv[i]);
+                return false;
+            }
+        } else {
+            return false;
         }
     }
+    return true;
 }
 
-int main(void) {
+int main(int argc, char** argv) {
+    if (!ParseArgs(argc, argv)) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    if (bench)
+        return RunBench();
+    if (headless)
+        return RunHeadless();
+
+    InitGrid();
+    if (patternPath && !LoadPattern(patternPath)) {
+        FreeAll();
+        return 1;
+    }
+
     InitWindow(screenWidth, screenHeight, "Wireworld Simulator");
     SetTargetFPS(60);
-
-    float elapsedTime = 0.0f;
+    // Escape also cancels a goto, so quitting on it is handled by hand.
+    SetExitKey(KEY_NULL);
 
     camera.zoom = 1.0f;
 
-    InitGrid();
+    StartSimulation();
+
+    while (!WindowShouldClose() && !quitRequested) {
+        const Snapshot* view = LatestSnapshot();
 
-    while (!WindowShouldClose()) {
         BeginDrawing();
 
         ClearBackground(RAYWHITE);
 
         BeginMode2D(camera);
 
-        float frameTime = GetFrameTime();
-        elapsedTime += frameTime;
+        DrawVisibleCells(view);
 
-        if (isPlaying && elapsedTime >= refreshInterval) {
-            UpdateGrid();
-            elapsedTime = 0.0f;
-        }
-
-        DrawVisibleCells();
-
-        HandleUserInput();
+        HandleUserInput(view);
 
         EndMode2D();
 
-        DrawUI();
+        DrawUI(view);
 
         EndDrawing();
     }
 
+    StopSimulation();
     CloseWindow();
 
-    FreeGrid();
+    FreeAll();
 
     return 0;
 }